@@ -0,0 +1,58 @@
+#ifndef S25ARCHIVESESSION_H
+#define S25ARCHIVESESSION_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <QPointF>
+#include <QString>
+#include <qopengl.h>
+
+#include "S25DecoderWrapper.h"
+#include "S25ImageCache.h"
+
+// State of one open archive (a tab in the viewer).
+//
+// Decoded images and GL objects of inactive sessions may be released by
+// S25MemoryGovernor at any time; `resident` tells whether `images`,
+// `textures` and `vertexBuffers` are valid and have to be rebuilt on switch.
+struct S25ArchiveSession {
+  S25ArchiveSession(QString const &thePath, S25pSharedArchive theArchive)
+      : path{thePath}, archive{std::move(theArchive)},
+        reader{archive.getReader()}, cache{},
+        imageEntries(archive.getTotalLayers(), -1), images{}, textures{},
+        textureImages{}, textureScale{1}, vertexBuffers{}, vertexOrigin{},
+        textureBytes{0}, resident{false}, lastUsed{0} {}
+
+  S25ArchiveSession(S25ArchiveSession const &) = delete;
+  S25ArchiveSession &operator=(S25ArchiveSession const &) = delete;
+
+  size_t getMemoryUsage() const {
+    return textureBytes + cache.getHotBytes() + cache.getWarmBytes();
+  }
+
+  QString           path;
+  S25pSharedArchive archive;
+  S25pArchiveReader reader; // for the GUI thread only
+  S25ImageCache     cache;
+
+  std::vector<int32_t>                          imageEntries;
+  std::vector<std::shared_ptr<const S25pImage>> images;
+
+  // images the textures were uploaded from, at `textureScale`; layers whose
+  // image is unchanged keep their texture
+  std::vector<GLuint>                           textures;
+  std::vector<std::shared_ptr<const S25pImage>> textureImages;
+  double                                        textureScale;
+
+  // quads of `images`, placed relative to `vertexOrigin`
+  std::vector<GLuint> vertexBuffers;
+  QPointF             vertexOrigin;
+  size_t              textureBytes;
+  bool                resident;
+
+  uint64_t lastUsed;
+};
+
+#endif // S25ARCHIVESESSION_H
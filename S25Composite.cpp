@@ -0,0 +1,86 @@
+#include "S25Composite.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+S25CompositeBounds S25GetCompositeBounds(S25LayerImages const &layers) {
+  int x1 = INT_MAX;
+  int y1 = INT_MAX;
+  int x2 = INT_MIN;
+  int y2 = INT_MIN;
+
+  for (auto const &layer : layers) {
+    if (!layer) {
+      continue;
+    }
+
+    x1 = std::min(x1, layer->getOffsetX());
+    y1 = std::min(y1, layer->getOffsetY());
+    x2 = std::max(x2, layer->getOffsetX() + layer->getWidth());
+    y2 = std::max(y2, layer->getOffsetY() + layer->getHeight());
+  }
+
+  if (x1 >= x2 || y1 >= y2) {
+    return S25CompositeBounds{0, 0, 0, 0};
+  }
+
+  return S25CompositeBounds{x1, y1, x2 - x1, y2 - y1};
+}
+
+void S25CompositeInto(uint8_t *bgra, S25CompositeBounds const &bounds,
+                      S25LayerImages const &layers) {
+  std::memset(bgra, 0, static_cast<size_t>(bounds.width) * bounds.height * 4);
+
+  for (auto const &layer : layers) {
+    if (!layer) {
+      continue;
+    }
+
+    auto src    = layer->getBGRABuffer(nullptr);
+    auto width  = layer->getWidth();
+    auto height = layer->getHeight();
+    auto left   = layer->getOffsetX() - bounds.x;
+    auto top    = layer->getOffsetY() - bounds.y;
+
+    for (int y = 0; y < height; y++) {
+      auto s = src + static_cast<size_t>(y) * width * 4;
+      auto d = bgra + (static_cast<size_t>(top + y) * bounds.width + left) * 4;
+
+      for (int x = 0; x < width; x++, s += 4, d += 4) {
+        uint32_t sa = s[3];
+
+        if (sa == 0) {
+          continue;
+        }
+
+        if (sa == 255) {
+          std::memcpy(d, s, 4);
+          continue;
+        }
+
+        // straight-alpha source-over, weights scaled by 255 * 255
+        uint32_t wSrc = sa * 255;
+        uint32_t wDst = d[3] * (255 - sa);
+        uint32_t wOut = wSrc + wDst;
+
+        for (int c = 0; c < 3; c++) {
+          d[c] = (s[c] * wSrc + d[c] * wDst + wOut / 2) / wOut;
+        }
+
+        d[3] = (wOut + 127) / 255;
+      }
+    }
+  }
+}
+
+S25pImage S25Composite(S25LayerImages const &layers) {
+  auto bounds = S25GetCompositeBounds(layers);
+
+  std::vector<uint8_t> buffer(static_cast<size_t>(bounds.width) *
+                              bounds.height * 4);
+  S25CompositeInto(buffer.data(), bounds, layers);
+
+  return S25pImage(bounds.width, bounds.height, bounds.x, bounds.y,
+                   std::move(buffer));
+}
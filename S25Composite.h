@@ -0,0 +1,30 @@
+#ifndef S25COMPOSITE_H
+#define S25COMPOSITE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "S25DecoderWrapper.h"
+
+using S25LayerImages = std::vector<std::shared_ptr<const S25pImage>>;
+
+// extent of the union of all layers, in image offset coordinates
+struct S25CompositeBounds {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+S25CompositeBounds S25GetCompositeBounds(S25LayerImages const &layers);
+
+// Blends `layers` bottom to top (source-over, straight alpha) into `bgra`,
+// which must hold bounds.width * bounds.height pixels.  Null layers are
+// skipped.
+void S25CompositeInto(uint8_t *bgra, S25CompositeBounds const &bounds,
+                      S25LayerImages const &layers);
+
+S25pImage S25Composite(S25LayerImages const &layers);
+
+#endif // S25COMPOSITE_H
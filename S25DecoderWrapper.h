@@ -2,7 +2,10 @@
 #define S25DECODERWRAPPER_HPP
 
 #include "s25decoder/S25Decoder.h"
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <vector>
 
 class S25pImage {
 public:
@@ -11,6 +14,12 @@ public:
     S25ImageGetOffset(m_inner, &m_x, &m_y);
   }
 
+  // image backed by a buffer owned on the C++ side (e.g. decompressed from a
+  // cache); `buffer` must hold width * height BGRA pixels.
+  S25pImage(int width, int height, int x, int y, std::vector<uint8_t> buffer)
+      : m_inner(nullptr), m_buffer(std::move(buffer)), m_width(width),
+        m_height(height), m_x(x), m_y(y) {}
+
   ~S25pImage() { S25ImageRelease(m_inner); }
 
   S25pImage(S25pImage const &) = delete;
@@ -21,11 +30,13 @@ public:
       return;
     }
 
-    this->m_inner = image.m_inner;
-    image.m_inner = nullptr;
-
-    S25ImageGetSize(m_inner, &m_width, &m_height);
-    S25ImageGetOffset(m_inner, &m_x, &m_y);
+    this->m_inner  = image.m_inner;
+    this->m_buffer = std::move(image.m_buffer);
+    this->m_width  = image.m_width;
+    this->m_height = image.m_height;
+    this->m_x      = image.m_x;
+    this->m_y      = image.m_y;
+    image.m_inner  = nullptr;
   }
 
   S25pImage &operator=(S25pImage &&image) {
@@ -33,16 +44,28 @@ public:
       return *this;
     }
 
-    this->m_inner = image.m_inner;
-    image.m_inner = nullptr;
+    S25ImageRelease(m_inner);
 
-    S25ImageGetSize(m_inner, &m_width, &m_height);
-    S25ImageGetOffset(m_inner, &m_x, &m_y);
+    this->m_inner  = image.m_inner;
+    this->m_buffer = std::move(image.m_buffer);
+    this->m_width  = image.m_width;
+    this->m_height = image.m_height;
+    this->m_x      = image.m_x;
+    this->m_y      = image.m_y;
+    image.m_inner  = nullptr;
 
     return *this;
   }
 
   const uint8_t *getBGRABuffer(size_t *bufferSize) const {
+    if (!m_inner) {
+      if (bufferSize) {
+        *bufferSize = m_buffer.size();
+      }
+
+      return m_buffer.data();
+    }
+
     return S25ImageGetBGRABufferView(m_inner, bufferSize);
   }
 
@@ -55,11 +78,12 @@ public:
   int getOffsetY() const { return m_y; }
 
 private:
-  S25Image *m_inner;
-  int       m_width;
-  int       m_height;
-  int       m_x;
-  int       m_y;
+  S25Image *           m_inner;
+  std::vector<uint8_t> m_buffer;
+  int                  m_width;
+  int                  m_height;
+  int                  m_x;
+  int                  m_y;
 };
 
 class S25pArchive {
@@ -111,4 +135,78 @@ private:
   S25Archive *m_inner;
 };
 
+// Per-thread decoding handle leased from an S25pSharedArchive.  A reader must
+// only be used by one thread at a time; it keeps the archive alive.
+class S25pArchiveReader {
+public:
+  S25pArchiveReader(std::shared_ptr<S25SharedArchive> archive)
+      : m_archive(std::move(archive)), m_inner(nullptr) {
+    if (m_archive) {
+      m_inner = S25SharedArchiveAcquireReader(m_archive.get());
+    }
+  }
+
+  ~S25pArchiveReader() {
+    if (m_archive) {
+      S25SharedArchiveReturnReader(m_archive.get(), m_inner);
+    }
+  }
+
+  S25pArchiveReader(S25pArchiveReader const &) = delete;
+  S25pArchiveReader &operator=(S25pArchiveReader const &) = delete;
+
+  S25pArchiveReader(S25pArchiveReader &&reader)
+      : m_archive(std::move(reader.m_archive)), m_inner(reader.m_inner) {
+    reader.m_inner = nullptr;
+  }
+
+  operator bool() const { return m_inner != nullptr; }
+
+  std::optional<S25pImage> getImage(size_t entry) {
+    if (!m_inner) {
+      return std::nullopt;
+    }
+
+    auto img = S25ArchiveLoadImage(m_inner, entry);
+
+    if (img) {
+      return std::make_optional(S25pImage(img));
+    } else {
+      return std::nullopt;
+    }
+  }
+
+private:
+  std::shared_ptr<S25SharedArchive> m_archive;
+  S25Archive *                      m_inner;
+};
+
+// Read-only archive that can be shared between threads.  Copies are cheap
+// and refer to the same archive; decode through getReader().
+class S25pSharedArchive {
+public:
+  // no archive; has no entries and hands out invalid readers
+  S25pSharedArchive() : m_inner() {}
+
+  S25pSharedArchive(const char *path)
+      : m_inner(S25SharedArchiveOpen(path), S25SharedArchiveRelease) {}
+
+  operator bool() const { return m_inner != nullptr; }
+
+  S25pArchiveReader getReader() const { return S25pArchiveReader(m_inner); }
+
+  size_t getTotalEntries() const {
+    if (!m_inner) {
+      return 0;
+    }
+
+    return S25SharedArchiveGetTotalEntries(m_inner.get());
+  }
+
+  size_t getTotalLayers() const { return getTotalEntries() / 100 + 1; }
+
+private:
+  std::shared_ptr<S25SharedArchive> m_inner;
+};
+
 #endif // S25DECODERWRAPPER_HPP
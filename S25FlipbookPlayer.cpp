@@ -0,0 +1,261 @@
+#include "S25FlipbookPlayer.h"
+
+#include <algorithm>
+#include <cmath>
+
+S25FlipbookPlayer::S25FlipbookPlayer(QObject *parent)
+    : QObject(parent), m_cache{nullptr}, m_layer{0}, m_frameRate{12.0},
+      m_playing{false}, m_lastSlot{-1}, m_currentPictLayer{-1},
+      m_shownFrames{0}, m_missedFrames{0}, m_generation{0},
+      m_nextSequence{0}, m_stopping{false} {
+  m_timer.setTimerType(Qt::PreciseTimer);
+  connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+S25FlipbookPlayer::~S25FlipbookPlayer() { stopDecoder(); }
+
+void S25FlipbookPlayer::start(S25pSharedArchive const &archive,
+                              S25ImageCache *cache, unsigned long layer,
+                              double frameRate) {
+  stopDecoder();
+
+  m_archive          = archive;
+  m_cache            = cache;
+  m_layer            = layer;
+  m_currentImage     = nullptr;
+  m_currentPictLayer = -1;
+  m_shownFrames      = 0;
+  m_missedFrames     = 0;
+  m_nextSequence     = 0;
+  m_stopping         = false;
+  m_playing          = true;
+
+  m_generation++;
+
+  m_decoder = std::thread([this] { decodeLoop(); });
+
+  setFrameRate(frameRate);
+}
+
+void S25FlipbookPlayer::stop() {
+  if (!m_playing) {
+    return;
+  }
+
+  stopDecoder();
+
+  emit playbackStopped();
+}
+
+void S25FlipbookPlayer::stopDecoder() {
+  if (!m_playing) {
+    return;
+  }
+
+  m_timer.stop();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+
+  m_cond.notify_all();
+  m_decoder.join();
+
+  m_frames.clear();
+  m_archive.reset();
+  m_cache   = nullptr;
+  m_playing = false;
+}
+
+void S25FlipbookPlayer::setFrameRate(double frameRate) {
+  m_frameRate = std::max(frameRate, 0.1);
+
+  if (!m_playing) {
+    return;
+  }
+
+  // tick twice per frame so that a late timer does not cost a whole frame
+  m_timer.start(std::max(1, static_cast<int>(500.0 / m_frameRate)));
+  restartClock();
+}
+
+bool S25FlipbookPlayer::isPlaying() const { return m_playing; }
+
+unsigned long S25FlipbookPlayer::getLayer() const { return m_layer; }
+
+double S25FlipbookPlayer::getFrameRate() const { return m_frameRate; }
+
+std::shared_ptr<const S25pImage> S25FlipbookPlayer::getCurrentImage() const {
+  return m_currentImage;
+}
+
+int S25FlipbookPlayer::getCurrentPictLayer() const {
+  return m_currentPictLayer;
+}
+
+std::shared_ptr<const S25pImage> S25FlipbookPlayer::getNextImage() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (m_frames.empty()) {
+    return nullptr;
+  }
+
+  return m_frames.front().image;
+}
+
+size_t S25FlipbookPlayer::getShownFrames() const { return m_shownFrames; }
+
+size_t S25FlipbookPlayer::getMissedFrames() const { return m_missedFrames; }
+
+void S25FlipbookPlayer::restartClock() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // renumber pending frames so that the oldest one is due right now
+  auto base = m_frames.empty() ? m_nextSequence : m_frames.front().sequence;
+
+  for (auto &frame : m_frames) {
+    frame.sequence -= base;
+  }
+
+  m_nextSequence -= base;
+
+  m_clock.start();
+  m_lastSlot = -1;
+}
+
+void S25FlipbookPlayer::tick() {
+  auto due = static_cast<int64_t>(
+      std::floor(m_clock.nsecsElapsed() * 1e-9 * m_frameRate));
+
+  // timer fired again within the same frame slot
+  if (due <= m_lastSlot) {
+    return;
+  }
+
+  bool  presented = false;
+  Frame frame;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // take the newest frame that is due; older ones are skipped
+    while (!m_frames.empty() &&
+           static_cast<int64_t>(m_frames.front().sequence) <= due) {
+      frame     = std::move(m_frames.front());
+      presented = true;
+      m_frames.pop_front();
+    }
+  }
+
+  m_cond.notify_one();
+
+  if (presented && static_cast<int64_t>(frame.sequence) == due) {
+    m_missedFrames += due - m_lastSlot - 1;
+  } else {
+    m_missedFrames += due - m_lastSlot;
+  }
+
+  m_lastSlot = due;
+
+  if (presented) {
+    m_currentImage     = std::move(frame.image);
+    m_currentPictLayer = frame.pictLayer;
+    m_shownFrames++;
+
+    emit frameChanged();
+  }
+
+  emit statisticsChanged(m_shownFrames, m_missedFrames);
+}
+
+void S25FlipbookPlayer::decoderFailed() {
+  // stop() on the GUI thread, unless playback was restarted meanwhile
+  auto generation = m_generation;
+
+  QMetaObject::invokeMethod(
+      this,
+      [this, generation] {
+        if (generation == m_generation) {
+          stop();
+        }
+      },
+      Qt::QueuedConnection);
+}
+
+void S25FlipbookPlayer::decoderQueued() {
+  auto generation = m_generation;
+
+  QMetaObject::invokeMethod(
+      this,
+      [this, generation] {
+        if (generation == m_generation && m_playing) {
+          emit frameDecoded();
+        }
+      },
+      Qt::QueuedConnection);
+}
+
+void S25FlipbookPlayer::decodeLoop() {
+  // decode through a reader of our own, next to the GUI thread's one
+  auto reader = m_archive->getReader();
+  if (!reader) {
+    decoderFailed();
+    return;
+  }
+
+  auto first = m_layer * 100;
+  auto last  = std::min<size_t>(first + 100, m_archive->getTotalEntries());
+
+  if (last <= first) {
+    decoderFailed();
+    return;
+  }
+
+  auto   candidates = last - first;
+  size_t next       = 0;
+  size_t emptyRun   = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] {
+        return m_stopping || m_frames.size() < kDecodeAhead;
+      });
+
+      if (m_stopping) {
+        return;
+      }
+    }
+
+    auto pictLayer = static_cast<int>(next);
+    auto image     = m_cache->getImage(reader, first + next);
+
+    next = (next + 1) % candidates;
+
+    // missing pict layers are skipped; give up if the layer has none at all
+    if (!image) {
+      if (++emptyRun >= candidates) {
+        decoderFailed();
+        return;
+      }
+
+      continue;
+    }
+
+    emptyRun = 0;
+
+    bool wasEmpty;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      wasEmpty = m_frames.empty();
+      m_frames.push_back(Frame{m_nextSequence++, pictLayer, std::move(image)});
+    }
+
+    // frames behind the first are picked up once it has been shown
+    if (wasEmpty) {
+      decoderQueued();
+    }
+  }
+}
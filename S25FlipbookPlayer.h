@@ -0,0 +1,106 @@
+#ifndef S25FLIPBOOKPLAYER_H
+#define S25FLIPBOOKPLAYER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+#include "S25DecoderWrapper.h"
+#include "S25ImageCache.h"
+
+// Cycles through the pict-layer entries of one layer at a fixed frame rate.
+//
+// Frames are decoded ahead on a worker thread (through the session cache, so
+// later loops are served from memory) and handed to the view once they are
+// due; frameDecoded() lets the view upload the next one ahead of time.
+// Frames that are not ready in time are counted as missed.  Playback stops
+// by itself (emitting playbackStopped()) if the layer has nothing to decode.
+class S25FlipbookPlayer : public QObject {
+  Q_OBJECT
+public:
+  // number of frames decoded ahead of the one being shown
+  static constexpr size_t kDecodeAhead = 4;
+
+  S25FlipbookPlayer(QObject *parent = nullptr);
+  ~S25FlipbookPlayer();
+
+  // `cache` must outlive the playback (i.e. until stop() is called)
+  void start(S25pSharedArchive const &archive, S25ImageCache *cache,
+             unsigned long layer, double frameRate);
+  void stop();
+  void setFrameRate(double frameRate);
+
+  bool          isPlaying() const;
+  unsigned long getLayer() const;
+  double        getFrameRate() const;
+
+  // frame currently due; valid after frameChanged() was emitted
+  std::shared_ptr<const S25pImage> getCurrentImage() const;
+  int                              getCurrentPictLayer() const;
+
+  // frame to be shown next, if it is decoded already
+  std::shared_ptr<const S25pImage> getNextImage() const;
+
+  size_t getShownFrames() const;
+  size_t getMissedFrames() const;
+
+signals:
+  void frameChanged();
+  // a frame was queued while none was pending, see getNextImage()
+  void frameDecoded();
+  void statisticsChanged(int shownFrames, int missedFrames);
+  void playbackStopped();
+
+private slots:
+  void tick();
+
+private:
+  struct Frame {
+    uint64_t                         sequence;
+    int                              pictLayer;
+    std::shared_ptr<const S25pImage> image;
+  };
+
+  std::optional<S25pSharedArchive> m_archive;
+  S25ImageCache *                  m_cache;
+  unsigned long                    m_layer;
+  double                           m_frameRate;
+  bool                             m_playing;
+
+  QTimer        m_timer;
+  QElapsedTimer m_clock;
+  int64_t       m_lastSlot;
+
+  std::shared_ptr<const S25pImage> m_currentImage;
+  int                              m_currentPictLayer;
+
+  size_t m_shownFrames;
+  size_t m_missedFrames;
+
+  // counts start() calls; a stop requested by an earlier decoder is ignored
+  uint64_t m_generation;
+
+  // shared with the decoder thread
+  std::thread             m_decoder;
+  std::deque<Frame>       m_frames;
+  uint64_t                m_nextSequence;
+  mutable std::mutex      m_mutex;
+  std::condition_variable m_cond;
+  bool                    m_stopping;
+
+  void decodeLoop();
+  void decoderFailed();
+  void decoderQueued();
+  void stopDecoder();
+  void restartClock();
+};
+
+#endif // S25FLIPBOOKPLAYER_H
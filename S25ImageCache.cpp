@@ -0,0 +1,336 @@
+#include "S25ImageCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// runs shorter than this are stored as literals
+constexpr size_t   kMinRunLength = 3;
+constexpr uint32_t kRunFlag      = 0x80000000u;
+constexpr uint32_t kMaxTokenSize = 0x7fffffffu;
+
+inline uint32_t loadPixel(const uint8_t *p) {
+  uint32_t px;
+  std::memcpy(&px, p, sizeof(px));
+  return px;
+}
+
+} // namespace
+
+double S25ImageCache::Statistics::getCompressionRatio() const {
+  if (warmCompressedBytes == 0) {
+    return 0.0;
+  }
+
+  return static_cast<double>(warmRawBytes) / warmCompressedBytes;
+}
+
+double S25ImageCache::Statistics::getDecompressThroughput() const {
+  if (decompressNanoseconds <= 0) {
+    return 0.0;
+  }
+
+  return static_cast<double>(decompressedBytes) * 1e9 / decompressNanoseconds;
+}
+
+S25ImageCache::S25ImageCache(size_t hotBudget, size_t warmBudget)
+    : m_hotBudget{hotBudget}, m_warmBudget{warmBudget}, m_hotBytes{0},
+      m_warmBytes{0} {}
+
+std::shared_ptr<const S25pImage>
+S25ImageCache::getImage(S25pArchiveReader &reader, size_t entry) {
+  if (auto image = lookup(entry)) {
+    return image;
+  }
+
+  // full decode; done outside the lock as it is by far the slowest path
+  return insertDecoded(entry, reader.getImage(entry));
+}
+
+std::shared_ptr<const S25pImage> S25ImageCache::lookup(size_t entry) {
+  WarmEntry w;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // hot tier: move to the front of the LRU list
+    auto hot = m_hotIndex.find(entry);
+    if (hot != m_hotIndex.end()) {
+      m_hot.splice(m_hot.begin(), m_hot, hot->second);
+      m_stats.hotHits++;
+      return hot->second->image;
+    }
+
+    auto warm = m_warmIndex.find(entry);
+    if (warm == m_warmIndex.end()) {
+      m_stats.misses++;
+      return nullptr;
+    }
+
+    w = *warm->second;
+  }
+
+  // warm tier: decompress without blocking other readers, then promote to
+  // the hot tier
+  auto pixelCount = static_cast<size_t>(w.width) * w.height;
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<uint8_t> buffer(pixelCount * 4);
+  decompressPixels(*w.data, buffer.data(), pixelCount);
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  auto bytes   = buffer.size();
+
+  auto image = std::make_shared<const S25pImage>(w.width, w.height, w.x, w.y,
+                                                 std::move(buffer));
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_stats.warmHits++;
+  m_stats.decompressedBytes += bytes;
+  m_stats.decompressNanoseconds +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+  // another caller may have promoted or decoded the entry in the meantime
+  auto hot = m_hotIndex.find(entry);
+  if (hot != m_hotIndex.end()) {
+    return hot->second->image;
+  }
+
+  auto warm = m_warmIndex.find(entry);
+  if (warm != m_warmIndex.end()) {
+    eraseWarm(warm->second);
+  }
+
+  insertHot(entry, image);
+  return image;
+}
+
+std::shared_ptr<const S25pImage>
+S25ImageCache::insertDecoded(size_t entry, std::optional<S25pImage> decoded) {
+  if (!decoded) {
+    return nullptr;
+  }
+
+  auto image = std::make_shared<const S25pImage>(std::move(*decoded));
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // another caller may have inserted the same entry in the meantime
+  auto hot = m_hotIndex.find(entry);
+  if (hot != m_hotIndex.end()) {
+    return hot->second->image;
+  }
+
+  // or evicted it into the warm tier; an entry lives in one tier only
+  auto warm = m_warmIndex.find(entry);
+  if (warm != m_warmIndex.end()) {
+    eraseWarm(warm->second);
+  }
+
+  insertHot(entry, image);
+  return image;
+}
+
+void S25ImageCache::setBudget(size_t hotBudget, size_t warmBudget) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_hotBudget  = hotBudget;
+  m_warmBudget = warmBudget;
+
+  trimHot();
+  trimWarm();
+}
+
+void S25ImageCache::evictHot() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  while (!m_hot.empty()) {
+    demoteHot();
+  }
+
+  trimWarm();
+}
+
+void S25ImageCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_hot.clear();
+  m_warm.clear();
+  m_hotIndex.clear();
+  m_warmIndex.clear();
+
+  m_hotBytes  = 0;
+  m_warmBytes = 0;
+
+  m_stats.warmRawBytes        = 0;
+  m_stats.warmCompressedBytes = 0;
+}
+
+size_t S25ImageCache::getHotBytes() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_hotBytes;
+}
+
+size_t S25ImageCache::getWarmBytes() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_warmBytes;
+}
+
+S25ImageCache::Statistics S25ImageCache::getStatistics() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+void S25ImageCache::insertHot(size_t                           entry,
+                              std::shared_ptr<const S25pImage> image) {
+  size_t bytes = 0;
+  image->getBGRABuffer(&bytes);
+
+  m_hot.push_front(HotEntry{entry, std::move(image), bytes});
+  m_hotIndex[entry] = m_hot.begin();
+  m_hotBytes += bytes;
+
+  trimHot();
+}
+
+void S25ImageCache::demoteHot() {
+  // least recently used image
+  auto &victim = m_hot.back();
+  auto &img    = *victim.image;
+
+  if (m_warmBudget > 0) {
+    auto pixelCount = static_cast<size_t>(img.getWidth()) * img.getHeight();
+
+    WarmEntry w{victim.entry, img.getWidth(), img.getHeight(),
+                img.getOffsetX(), img.getOffsetY(),
+                std::make_shared<const std::vector<uint32_t>>(
+                    compressPixels(img.getBGRABuffer(nullptr), pixelCount))};
+
+    auto compressedBytes = w.data->size() * sizeof(uint32_t);
+
+    m_warm.push_front(std::move(w));
+    m_warmIndex[victim.entry] = m_warm.begin();
+    m_warmBytes += compressedBytes;
+
+    m_stats.warmRawBytes += pixelCount * 4;
+    m_stats.warmCompressedBytes += compressedBytes;
+  }
+
+  m_hotBytes -= victim.bytes;
+  m_hotIndex.erase(victim.entry);
+  m_hot.pop_back();
+}
+
+void S25ImageCache::trimHot() {
+  // always keep the most recently used image, even if it exceeds the budget
+  while (m_hotBytes > m_hotBudget && m_hot.size() > 1) {
+    demoteHot();
+  }
+
+  trimWarm();
+}
+
+void S25ImageCache::eraseWarm(WarmList::iterator warm) {
+  auto compressedBytes = warm->data->size() * sizeof(uint32_t);
+
+  m_warmBytes -= compressedBytes;
+  m_stats.warmRawBytes -= static_cast<size_t>(warm->width) * warm->height * 4;
+  m_stats.warmCompressedBytes -= compressedBytes;
+
+  m_warmIndex.erase(warm->entry);
+  m_warm.erase(warm);
+}
+
+void S25ImageCache::trimWarm() {
+  while (m_warmBytes > m_warmBudget && !m_warm.empty()) {
+    eraseWarm(std::prev(m_warm.end()));
+  }
+}
+
+// The stream is a sequence of tokens. A token header with kRunFlag set is
+// followed by a single pixel repeated `header & kMaxTokenSize` times;
+// otherwise the header is followed by that many literal pixels.  Transparent
+// regions of S25 layers collapse into a couple of words.
+std::vector<uint32_t> S25ImageCache::compressPixels(const uint8_t *bgra,
+                                                    size_t         pixelCount) {
+  std::vector<uint32_t> out;
+  out.reserve(pixelCount / 4 + 16);
+
+  size_t i            = 0;
+  size_t literalStart = 0;
+
+  auto flushLiterals = [&](size_t end) {
+    while (literalStart < end) {
+      auto count = std::min<size_t>(end - literalStart, kMaxTokenSize);
+
+      out.push_back(static_cast<uint32_t>(count));
+
+      auto pos = out.size();
+      out.resize(pos + count);
+      std::memcpy(out.data() + pos, bgra + literalStart * 4, count * 4);
+
+      literalStart += count;
+    }
+  };
+
+  while (i < pixelCount) {
+    auto   px  = loadPixel(bgra + i * 4);
+    size_t run = 1;
+
+    while (i + run < pixelCount && run < kMaxTokenSize &&
+           loadPixel(bgra + (i + run) * 4) == px) {
+      run++;
+    }
+
+    if (run >= kMinRunLength) {
+      flushLiterals(i);
+
+      out.push_back(kRunFlag | static_cast<uint32_t>(run));
+      out.push_back(px);
+
+      i += run;
+      literalStart = i;
+    } else {
+      i += run;
+    }
+  }
+
+  flushLiterals(pixelCount);
+
+  out.shrink_to_fit();
+  return out;
+}
+
+void S25ImageCache::decompressPixels(const std::vector<uint32_t> &compressed,
+                                     uint8_t *bgra, size_t pixelCount) {
+  auto dst = bgra;
+  auto end = bgra + pixelCount * 4;
+
+  for (size_t i = 0; i < compressed.size() && dst < end;) {
+    auto header = compressed[i++];
+    auto count  = static_cast<size_t>(header & kMaxTokenSize);
+
+    count = std::min<size_t>(count, (end - dst) / 4);
+
+    if (header & kRunFlag) {
+      auto px = compressed[i++];
+
+      // both loops below are trivially vectorised by the compiler
+      if (px == 0) {
+        std::memset(dst, 0, count * 4);
+      } else {
+        auto out = reinterpret_cast<uint32_t *>(dst);
+        std::fill_n(out, count, px);
+      }
+    } else {
+      std::memcpy(dst, compressed.data() + i, count * 4);
+      i += header & kMaxTokenSize;
+    }
+
+    dst += count * 4;
+  }
+}
@@ -0,0 +1,112 @@
+#ifndef S25IMAGECACHE_H
+#define S25IMAGECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "S25DecoderWrapper.h"
+
+// Two-tier cache of decoded S25 entries.
+//
+// Recently used images are kept as raw BGRA (hot tier).  Images evicted from
+// the hot tier are run-length compressed and kept in the warm tier, which is
+// far cheaper to restore than a full S25ArchiveLoadImage decode.
+class S25ImageCache {
+public:
+  static constexpr size_t kDefaultHotBudget  = 256 * 1024 * 1024;
+  static constexpr size_t kDefaultWarmBudget = 128 * 1024 * 1024;
+
+  struct Statistics {
+    size_t hotHits  = 0;
+    size_t warmHits = 0;
+    size_t misses   = 0;
+
+    // bytes held by the warm tier, before and after compression
+    size_t warmRawBytes        = 0;
+    size_t warmCompressedBytes = 0;
+
+    // accumulated cost of restoring images from the warm tier
+    size_t  decompressedBytes     = 0;
+    int64_t decompressNanoseconds = 0;
+
+    double getCompressionRatio() const;
+    double getDecompressThroughput() const; // bytes per second
+  };
+
+  S25ImageCache(size_t hotBudget  = kDefaultHotBudget,
+                size_t warmBudget = kDefaultWarmBudget);
+
+  S25ImageCache(S25ImageCache const &) = delete;
+  S25ImageCache &operator=(S25ImageCache const &) = delete;
+
+  // returns the decoded entry, or nullptr if the entry could not be decoded;
+  // safe to call from several threads when each uses its own reader
+  std::shared_ptr<const S25pImage> getImage(S25pArchiveReader &reader,
+                                            size_t             entry);
+
+  void setBudget(size_t hotBudget, size_t warmBudget);
+  // moves every hot image into the warm tier (or drops it without a warm
+  // budget); trimming always keeps the most recently used one
+  void evictHot();
+  void clear();
+
+  size_t     getHotBytes() const;
+  size_t     getWarmBytes() const;
+  Statistics getStatistics() const;
+
+  // run-length codec over 32-bit BGRA pixels
+  static std::vector<uint32_t> compressPixels(const uint8_t *bgra,
+                                              size_t         pixelCount);
+  static void decompressPixels(const std::vector<uint32_t> &compressed,
+                               uint8_t *bgra, size_t pixelCount);
+
+private:
+  struct HotEntry {
+    size_t                           entry;
+    std::shared_ptr<const S25pImage> image;
+    size_t                           bytes;
+  };
+
+  struct WarmEntry {
+    size_t entry;
+    int    width;
+    int    height;
+    int    x;
+    int    y;
+    // shared so that lookup() can decompress it without holding the lock
+    std::shared_ptr<const std::vector<uint32_t>> data;
+  };
+
+  using HotList  = std::list<HotEntry>;
+  using WarmList = std::list<WarmEntry>;
+
+  HotList                                        m_hot;
+  WarmList                                       m_warm;
+  std::unordered_map<size_t, HotList::iterator>  m_hotIndex;
+  std::unordered_map<size_t, WarmList::iterator> m_warmIndex;
+
+  size_t m_hotBudget;
+  size_t m_warmBudget;
+  size_t m_hotBytes;
+  size_t m_warmBytes;
+
+  Statistics         m_stats;
+  mutable std::mutex m_mutex;
+
+  std::shared_ptr<const S25pImage> lookup(size_t entry);
+  std::shared_ptr<const S25pImage>
+  insertDecoded(size_t entry, std::optional<S25pImage> decoded);
+
+  void insertHot(size_t entry, std::shared_ptr<const S25pImage> image);
+  void eraseWarm(WarmList::iterator warm);
+  void demoteHot();
+  void trimHot();
+  void trimWarm();
+};
+
+#endif // S25IMAGECACHE_H
@@ -0,0 +1,566 @@
+#include "S25KernelCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <QtGlobal>
+
+#include "S25ImageCache.h"
+#include "S25PixelFormat.h"
+#include "S25Resample.h"
+
+namespace {
+
+// around the 4, 8 and 32 pixel steps of the SIMD kernels, so that every
+// tail path runs
+constexpr size_t kPixelCounts[] = {0,  1,  3,  4,  5,  7,  8,  9,
+                                   15, 16, 17, 31, 32, 33, 63, 1021};
+
+constexpr unsigned kConversions[] = {
+    kS25ConvertSwizzleRGBA,
+    kS25ConvertPremultiply,
+    kS25ConvertSwizzleRGBA | kS25ConvertPremultiply,
+};
+
+constexpr S25ResampleFilter kFilters[] = {
+    S25ResampleFilter::kBox,
+    S25ResampleFilter::kBilinear,
+    S25ResampleFilter::kLanczos3,
+};
+
+// largest per-channel difference accepted between resample kernel sets,
+// which sum the taps in a different order
+constexpr int kResampleTolerance = 1;
+
+// and after halving and doubling a smooth gradient
+constexpr int kRoundTripTolerance = 4;
+
+// xorshift32; the check has to be reproducible
+class Random {
+public:
+  explicit Random(uint32_t seed) : m_state{seed * 2654435761u + 1} {}
+
+  uint32_t next() {
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state;
+  }
+
+  uint8_t nextByte() { return static_cast<uint8_t>(next() >> 24); }
+
+private:
+  uint32_t m_state;
+};
+
+// straight BGRA pixels; a quarter each fully transparent (with leftover
+// colour) and opaque, the rest translucent
+std::vector<uint8_t> makePixels(size_t count, uint32_t seed) {
+  Random               random(seed);
+  std::vector<uint8_t> pixels(count * 4);
+
+  for (size_t i = 0; i < count; i++) {
+    auto p = &pixels[i * 4];
+
+    p[0] = random.nextByte();
+    p[1] = random.nextByte();
+    p[2] = random.nextByte();
+
+    switch (random.next() % 4) {
+    case 0:
+      p[3] = 0;
+      break;
+    case 1:
+      p[3] = 255;
+      break;
+    default:
+      p[3] = random.nextByte();
+    }
+  }
+
+  return pixels;
+}
+
+// c * a / 255, rounded to nearest
+uint8_t premultiplyChannel(int c, int a) {
+  return static_cast<uint8_t>((c * a * 2 + 255) / 510);
+}
+
+int maxDifference(std::vector<uint8_t> const &a,
+                  std::vector<uint8_t> const &b) {
+  int diff = 0;
+
+  for (size_t i = 0; i < a.size(); i++) {
+    diff = std::max(diff, std::abs(a[i] - b[i]));
+  }
+
+  return diff;
+}
+
+size_t getScalarPixelSet() { return S25GetPixelKernelSetCount() - 1; }
+
+size_t getScalarResampleSet() { return S25GetResampleKernelSetCount() - 1; }
+
+// the scalar set against the definition, every other set against the scalar
+// one, out of place and in place
+bool checkConversions() {
+  auto   scalar     = getScalarPixelSet();
+  size_t mismatches = 0;
+
+  for (auto count : kPixelCounts) {
+    auto src = makePixels(count, static_cast<uint32_t>(count));
+
+    for (auto conversions : kConversions) {
+      std::vector<uint8_t> expected(count * 4);
+
+      for (size_t i = 0; i < count; i++) {
+        auto s = &src[i * 4];
+        auto d = &expected[i * 4];
+
+        std::memcpy(d, s, 4);
+
+        if (conversions & kS25ConvertSwizzleRGBA) {
+          std::swap(d[0], d[2]);
+        }
+
+        if (conversions & kS25ConvertPremultiply) {
+          for (int c = 0; c < 3; c++) {
+            d[c] = premultiplyChannel(d[c], d[3]);
+          }
+        }
+      }
+
+      std::vector<uint8_t> actual(count * 4);
+      S25ConvertPixelsUsing(scalar, actual.data(), src.data(), count,
+                            conversions);
+
+      if (actual != expected) {
+        qCritical("convert, scalar: %zu pixels, conversions %u differ from "
+                  "the definition",
+                  count, conversions);
+        mismatches++;
+      }
+    }
+  }
+
+  auto passed = mismatches == 0;
+
+  for (size_t set = 0; set < scalar; set++) {
+    auto   name  = S25GetPixelKernelSetName(set);
+    size_t cases = 0;
+
+    mismatches = 0;
+
+    for (auto count : kPixelCounts) {
+      auto src = makePixels(count, static_cast<uint32_t>(count) + 1);
+
+      for (auto conversions : kConversions) {
+        std::vector<uint8_t> expected(count * 4);
+        std::vector<uint8_t> actual(count * 4);
+
+        S25ConvertPixelsUsing(scalar, expected.data(), src.data(), count,
+                              conversions);
+        S25ConvertPixelsUsing(set, actual.data(), src.data(), count,
+                              conversions);
+
+        auto inPlace = src;
+        S25ConvertPixelsUsing(set, inPlace.data(), inPlace.data(), count,
+                              conversions);
+
+        cases++;
+
+        if (actual != expected || inPlace != expected) {
+          qCritical("convert, %s: %zu pixels, conversions %u differ from "
+                    "scalar",
+                    name, count, conversions);
+          mismatches++;
+        }
+      }
+    }
+
+    qInfo("convert, %s: %zu cases, %zu differ from scalar", name, cases,
+          mismatches);
+
+    passed = passed && mismatches == 0;
+  }
+
+  return passed;
+}
+
+// opaque-ish rectangles at every position across the vector widths, and a
+// fully transparent image
+bool checkAlphaBounds() {
+  auto   sets       = S25GetPixelKernelSetCount();
+  size_t cases      = 0;
+  size_t mismatches = 0;
+  Random random(7);
+
+  for (int width = 1; width <= 70; width++) {
+    auto height = 1 + width % 5;
+    auto pixels = makePixels(static_cast<size_t>(width) * height, width);
+
+    // nothing visible
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+      pixels[i + 3] = 0;
+    }
+
+    std::vector<S25AlphaBounds> expected{{0, 0, 0, 0}};
+
+    // then one rectangle of non-zero alpha per round
+    for (int round = 0; round < 4; round++) {
+      auto x1 = static_cast<int>(random.next() % width);
+      auto x2 = x1 + static_cast<int>(random.next() % (width - x1));
+      auto y1 = static_cast<int>(random.next() % height);
+      auto y2 = y1 + static_cast<int>(random.next() % (height - y1));
+
+      expected.push_back(S25AlphaBounds{x1, y1, x2 - x1 + 1, y2 - y1 + 1});
+    }
+
+    for (auto const &bounds : expected) {
+      auto image = pixels;
+
+      for (int y = bounds.y; y < bounds.y + bounds.height; y++) {
+        for (int x = bounds.x; x < bounds.x + bounds.width; x++) {
+          image[(static_cast<size_t>(y) * width + x) * 4 + 3] =
+              static_cast<uint8_t>(1 + random.next() % 255);
+        }
+      }
+
+      for (size_t set = 0; set < sets; set++) {
+        auto actual = S25GetAlphaBoundsUsing(set, image.data(), width, height);
+
+        cases++;
+
+        if (actual.x != bounds.x || actual.y != bounds.y ||
+            actual.width != bounds.width || actual.height != bounds.height) {
+          qCritical("alpha bounds, %s: %dx%d image, got %d,%d %dx%d instead "
+                    "of %d,%d %dx%d",
+                    S25GetPixelKernelSetName(set), width, height, actual.x,
+                    actual.y, actual.width, actual.height, bounds.x, bounds.y,
+                    bounds.width, bounds.height);
+          mismatches++;
+        }
+      }
+    }
+  }
+
+  qInfo("alpha bounds: %zu cases, %zu wrong", cases, mismatches);
+
+  return mismatches == 0;
+}
+
+// every premultiplied value survives unpremultiplying and premultiplying
+// again; opaque pixels are unchanged and transparent ones turn black
+bool checkUnpremultiply() {
+  size_t mismatches = 0;
+
+  for (int a = 0; a < 256; a++) {
+    std::vector<uint8_t> premultiplied;
+
+    for (int c = 0; c < 256; c++) {
+      auto p = premultiplyChannel(c, a);
+      premultiplied.insert(premultiplied.end(),
+                           {p, p, p, static_cast<uint8_t>(a)});
+    }
+
+    std::vector<uint8_t> straight(premultiplied.size());
+    S25UnpremultiplyPixels(straight.data(), premultiplied.data(), 256);
+
+    for (int c = 0; c < 256; c++) {
+      auto p = &premultiplied[c * 4];
+      auto s = &straight[c * 4];
+
+      bool ok = s[3] == a && premultiplyChannel(s[0], a) == p[0];
+
+      if (a == 255) {
+        ok = ok && s[0] == c;
+      } else if (a == 0) {
+        ok = ok && s[0] == 0 && s[1] == 0 && s[2] == 0;
+      }
+
+      if (!ok) {
+        mismatches++;
+      }
+    }
+  }
+
+  // in place
+  auto pixels = makePixels(1021, 11);
+  S25ConvertPixels(pixels.data(), pixels.data(), 1021, kS25ConvertPremultiply);
+
+  auto copy = pixels;
+  S25UnpremultiplyPixels(copy.data(), copy.data(), 1021);
+  S25ConvertPixels(copy.data(), copy.data(), 1021, kS25ConvertPremultiply);
+
+  if (copy != pixels) {
+    mismatches++;
+  }
+
+  qInfo("unpremultiply: %zu mismatches", mismatches);
+
+  return mismatches == 0;
+}
+
+// every 8-bit value in every channel survives the trip to linear and back;
+// the curve is monotonic and spans 0..1
+bool checkSRGB() {
+  std::vector<uint8_t> pixels(256 * 4);
+
+  for (int i = 0; i < 256; i++) {
+    std::fill_n(&pixels[i * 4], 4, static_cast<uint8_t>(i));
+  }
+
+  std::vector<float>   linear(pixels.size());
+  std::vector<uint8_t> back(pixels.size());
+
+  S25SRGBToLinear(linear.data(), pixels.data(), 256);
+  S25LinearToSRGB(back.data(), linear.data(), 256);
+
+  size_t mismatches = 0;
+
+  for (int i = 0; i < 256; i++) {
+    for (int c = 0; c < 4; c++) {
+      if (back[i * 4 + c] != i) {
+        mismatches++;
+      }
+    }
+
+    if (i > 0 && linear[i * 4] <= linear[(i - 1) * 4]) {
+      mismatches++;
+    }
+  }
+
+  if (linear[0] != 0.0f || linear[255 * 4] != 1.0f ||
+      std::abs(linear[128 * 4] - 0.21586f) > 1e-4f) {
+    mismatches++;
+  }
+
+  qInfo("sRGB: %zu mismatches", mismatches);
+
+  return mismatches == 0;
+}
+
+bool checkKernelNames() {
+  std::string pixelNames;
+  std::string resampleNames;
+  bool        hasAVX2 = false;
+
+  for (size_t set = 0; set < S25GetPixelKernelSetCount(); set++) {
+    auto name = S25GetPixelKernelSetName(set);
+
+    pixelNames += (set ? " " : "") + std::string(name);
+    hasAVX2 = hasAVX2 || std::strcmp(name, "avx2") == 0;
+  }
+
+  for (size_t set = 0; set < S25GetResampleKernelSetCount(); set++) {
+    resampleNames += (set ? " " : "") +
+                     std::string(S25GetResampleKernelSetName(set));
+  }
+
+  auto inUse = S25GetPixelKernelName();
+
+  qInfo("pixel kernels: %s (using %s); resample kernels: %s",
+        pixelNames.c_str(), inUse, resampleNames.c_str());
+
+  // the fastest set is the one in use, the scalar sets are always there,
+  // and AVX2 is offered exactly when the CPU has it
+  auto passed =
+      std::strcmp(inUse, S25GetPixelKernelSetName(0)) == 0 &&
+      std::strcmp(S25GetPixelKernelSetName(getScalarPixelSet()), "scalar") ==
+          0 &&
+      std::strcmp(S25GetResampleKernelSetName(getScalarResampleSet()),
+                  "scalar") == 0 &&
+      hasAVX2 == S25CpuHasAVX2();
+
+  if (!passed) {
+    qCritical("kernel names do not match the CPU");
+  }
+
+  return passed;
+}
+
+bool checkRunLength() {
+  std::vector<std::vector<uint8_t>> images;
+
+  for (auto count : kPixelCounts) {
+    images.push_back(makePixels(count, static_cast<uint32_t>(count) + 3));
+  }
+
+  // runs of every length up to past kMinRunLength, and one long run
+  std::vector<uint8_t> runs;
+
+  for (int length = 1; length <= 6; length++) {
+    for (int i = 0; i < length; i++) {
+      runs.insert(runs.end(), {static_cast<uint8_t>(length), 1, 2, 255});
+    }
+  }
+
+  runs.resize(runs.size() + 4096 * 4, 0);
+  images.push_back(runs);
+
+  size_t mismatches = 0;
+
+  for (auto const &image : images) {
+    auto count      = image.size() / 4;
+    auto compressed = S25ImageCache::compressPixels(image.data(), count);
+
+    std::vector<uint8_t> restored(image.size(), 0xcd);
+    S25ImageCache::decompressPixels(compressed, restored.data(), count);
+
+    if (restored != image) {
+      mismatches++;
+    }
+  }
+
+  // a transparent layer collapses into a single run
+  std::vector<uint8_t> transparent(640 * 480 * 4, 0);
+
+  auto compressed =
+      S25ImageCache::compressPixels(transparent.data(), 640 * 480);
+
+  if (compressed.size() != 2) {
+    mismatches++;
+  }
+
+  qInfo("run-length: %zu images, %zu mismatches", images.size() + 1,
+        mismatches);
+
+  return mismatches == 0;
+}
+
+// opaque gradient, smooth enough to survive halving
+std::vector<uint8_t> makeGradient(int width, int height) {
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      auto p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+
+      p[0] = static_cast<uint8_t>(x * 255 / (width - 1));
+      p[1] = static_cast<uint8_t>(y * 255 / (height - 1));
+      p[2] = static_cast<uint8_t>((x + y) * 255 / (width + height - 2));
+      p[3] = 255;
+    }
+  }
+
+  return pixels;
+}
+
+bool checkResample() {
+  auto scalar = getScalarResampleSet();
+  bool passed = true;
+
+  struct Size {
+    int width;
+    int height;
+  };
+
+  constexpr Size kSource     = {37, 23};
+  constexpr Size kTargets[] = {{13, 9}, {37, 23}, {80, 50}, {1, 1}};
+
+  auto src = makePixels(static_cast<size_t>(kSource.width) * kSource.height,
+                        5);
+
+  // every set against the scalar one, on one and on several threads
+  for (size_t set = 0; set < scalar; set++) {
+    int maxDiff = 0;
+
+    for (auto filter : kFilters) {
+      for (auto target : kTargets) {
+        auto size = static_cast<size_t>(target.width) * target.height * 4;
+
+        std::vector<uint8_t> expected(size);
+        std::vector<uint8_t> actual(size);
+
+        S25ResampleIntoUsing(scalar, src.data(), kSource.width,
+                             kSource.height, expected.data(), target.width,
+                             target.height, filter, 1);
+
+        for (int threads : {1, 3}) {
+          S25ResampleIntoUsing(set, src.data(), kSource.width, kSource.height,
+                               actual.data(), target.width, target.height,
+                               filter, threads);
+
+          maxDiff = std::max(maxDiff, maxDifference(actual, expected));
+        }
+      }
+    }
+
+    qInfo("resample, %s: max difference %d from scalar",
+          S25GetResampleKernelSetName(set), maxDiff);
+
+    passed = passed && maxDiff <= kResampleTolerance;
+  }
+
+  // the same size reproduces the image, with transparent pixels cleared
+  auto identical = src;
+
+  for (size_t i = 0; i < identical.size(); i += 4) {
+    if (identical[i + 3] == 0) {
+      std::fill_n(&identical[i], 3, 0);
+    }
+  }
+
+  auto gradient = makeGradient(64, 64);
+
+  for (auto filter : kFilters) {
+    std::vector<uint8_t> out(src.size());
+
+    S25ResampleInto(src.data(), kSource.width, kSource.height, out.data(),
+                    kSource.width, kSource.height, filter);
+
+    auto identityDiff = maxDifference(out, identical);
+
+    // halved and doubled again, compared away from the edges
+    std::vector<uint8_t> half(32 * 32 * 4);
+    std::vector<uint8_t> restored(gradient.size());
+
+    S25ResampleInto(gradient.data(), 64, 64, half.data(), 32, 32, filter);
+    S25ResampleInto(half.data(), 32, 32, restored.data(), 64, 64, filter);
+
+    int roundTripDiff = 0;
+
+    for (int y = 4; y < 60; y++) {
+      for (int x = 4; x < 60; x++) {
+        for (int c = 0; c < 4; c++) {
+          auto i        = (static_cast<size_t>(y) * 64 + x) * 4 + c;
+          roundTripDiff = std::max(roundTripDiff,
+                                   std::abs(restored[i] - gradient[i]));
+        }
+      }
+    }
+
+    qInfo("resample, filter %d: identity max difference %d, round trip %d",
+          static_cast<int>(filter), identityDiff, roundTripDiff);
+
+    passed = passed && identityDiff <= kResampleTolerance &&
+             roundTripDiff <= kRoundTripTolerance;
+  }
+
+  return passed;
+}
+
+} // namespace
+
+int S25RunKernelCheck() {
+  auto passed = checkKernelNames();
+
+  passed = checkConversions() && passed;
+  passed = checkAlphaBounds() && passed;
+  passed = checkUnpremultiply() && passed;
+  passed = checkSRGB() && passed;
+  passed = checkRunLength() && passed;
+  passed = checkResample() && passed;
+
+  if (!passed) {
+    qCritical("kernel check failed");
+    return 1;
+  }
+
+  qInfo("kernel check passed");
+  return 0;
+}
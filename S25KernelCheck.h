@@ -0,0 +1,15 @@
+#ifndef S25KERNELCHECK_H
+#define S25KERNELCHECK_H
+
+// Regression check of the CPU pixel kernels (`S25Viewer --kernel-check`).
+//
+// Runs every kernel set of S25PixelFormat and S25Resample that the CPU
+// supports against the scalar one, on pixel counts around the vector widths
+// so that every tail path is taken.  Also checks unpremultiplication, the
+// sRGB conversions, alpha bounds, the reported kernel names and round trips
+// through the run-length codec of S25ImageCache and through S25Resample.
+// Needs neither a display nor an archive; returns the process exit code,
+// nonzero when a check fails.
+int S25RunKernelCheck();
+
+#endif // S25KERNELCHECK_H
@@ -0,0 +1,80 @@
+#include "S25MemoryGovernor.h"
+
+#include <algorithm>
+
+S25MemoryGovernor::S25MemoryGovernor(size_t budget)
+    : m_budget{budget}, m_clock{0} {}
+
+void S25MemoryGovernor::setBudget(size_t budget) { m_budget = budget; }
+
+size_t S25MemoryGovernor::getBudget() const { return m_budget; }
+
+void S25MemoryGovernor::activate(S25ArchiveSession &session) {
+  session.lastUsed = ++m_clock;
+  session.cache.setBudget(S25ImageCache::kDefaultHotBudget,
+                          S25ImageCache::kDefaultWarmBudget);
+}
+
+size_t S25MemoryGovernor::getUsage(
+    std::vector<S25ArchiveSession *> const &sessions) const {
+  size_t usage = 0;
+
+  for (auto session : sessions) {
+    usage += session->getMemoryUsage();
+  }
+
+  return usage;
+}
+
+void S25MemoryGovernor::enforce(
+    std::vector<S25ArchiveSession *> const &sessions,
+    S25ArchiveSession const *active, ReleaseTexturesFn const &releaseTextures) {
+  if (getUsage(sessions) <= m_budget) {
+    return;
+  }
+
+  // least recently used inactive sessions first
+  std::vector<S25ArchiveSession *> victims;
+
+  for (auto session : sessions) {
+    if (session != active) {
+      victims.push_back(session);
+    }
+  }
+
+  std::sort(victims.begin(), victims.end(),
+            [](S25ArchiveSession const *a, S25ArchiveSession const *b) {
+              return a->lastUsed < b->lastUsed;
+            });
+
+  // 1. GL textures and vertex buffers
+  for (auto session : victims) {
+    if (session->resident) {
+      releaseTextures(*session);
+    }
+
+    if (getUsage(sessions) <= m_budget) {
+      return;
+    }
+  }
+
+  // 2. raw decoded images; they move into the compressed tier
+  for (auto session : victims) {
+    session->images.clear();
+    session->cache.setBudget(0, S25ImageCache::kDefaultWarmBudget);
+    session->cache.evictHot();
+
+    if (getUsage(sessions) <= m_budget) {
+      return;
+    }
+  }
+
+  // 3. the compressed tier
+  for (auto session : victims) {
+    session->cache.setBudget(0, 0);
+
+    if (getUsage(sessions) <= m_budget) {
+      return;
+    }
+  }
+}
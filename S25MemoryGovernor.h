@@ -0,0 +1,41 @@
+#ifndef S25MEMORYGOVERNOR_H
+#define S25MEMORYGOVERNOR_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "S25ArchiveSession.h"
+
+// Keeps the textures and decoded buffers of all open archives under a single
+// memory budget.  Inactive sessions are evicted first, least recently used
+// first: their textures, then their raw decoded images (which drop into the
+// compressed cache tier), then the compressed tier itself.
+class S25MemoryGovernor {
+public:
+  static constexpr size_t kDefaultBudget = 1024 * 1024 * 1024;
+
+  using ReleaseTexturesFn = std::function<void(S25ArchiveSession &)>;
+
+  S25MemoryGovernor(size_t budget = kDefaultBudget);
+
+  void   setBudget(size_t budget);
+  size_t getBudget() const;
+
+  // marks `session` as the most recently used one and restores its caches
+  void activate(S25ArchiveSession &session);
+
+  size_t getUsage(std::vector<S25ArchiveSession *> const &sessions) const;
+
+  // evicts until the usage fits the budget or only the active session is
+  // left; `releaseTextures` must free the GL objects of the given session
+  void enforce(std::vector<S25ArchiveSession *> const &sessions,
+               S25ArchiveSession const *               active,
+               ReleaseTexturesFn const &               releaseTextures);
+
+private:
+  size_t   m_budget;
+  uint64_t m_clock;
+};
+
+#endif // S25MEMORYGOVERNOR_H
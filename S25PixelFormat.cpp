@@ -0,0 +1,466 @@
+#include "S25PixelFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||           \
+    defined(_M_IX86)
+#define S25_PIXEL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC accepts any intrinsic without per-function target flags
+#define S25_TARGET(x)
+#else
+#define S25_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define S25_PIXEL_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// scalar kernels; also used for the tails of the SIMD ones
+
+// c * a / 255, rounded
+inline uint8_t mulDiv255(uint32_t c, uint32_t a) {
+  auto t = c * a + 128;
+  return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+}
+
+void convertScalar(uint8_t *dst, const uint8_t *src, size_t n,
+                   unsigned conversions) {
+  auto swizzle     = (conversions & kS25ConvertSwizzleRGBA) != 0;
+  auto premultiply = (conversions & kS25ConvertPremultiply) != 0;
+
+  for (size_t i = 0; i < n; i++, src += 4, dst += 4) {
+    uint8_t p[4] = {src[0], src[1], src[2], src[3]};
+
+    if (swizzle) {
+      std::swap(p[0], p[2]);
+    }
+
+    if (premultiply) {
+      p[0] = mulDiv255(p[0], p[3]);
+      p[1] = mulDiv255(p[1], p[3]);
+      p[2] = mulDiv255(p[2], p[3]);
+    }
+
+    std::memcpy(dst, p, 4);
+  }
+}
+
+// first and last pixel with non-zero alpha in [begin, end), or -1
+void alphaExtentScalar(const uint8_t *row, int begin, int end, int *first,
+                       int *last) {
+  *first = -1;
+  *last  = -1;
+
+  for (int x = begin; x < end; x++) {
+    if (row[x * 4 + 3]) {
+      *first = x;
+      break;
+    }
+  }
+
+  if (*first == -1) {
+    return;
+  }
+
+  for (int x = end - 1; x >= *first; x--) {
+    if (row[x * 4 + 3]) {
+      *last = x;
+      break;
+    }
+  }
+}
+
+#if defined(S25_PIXEL_X86)
+
+// c * a / 255 on 16-bit lanes of two unpacked pixels; alpha is kept
+inline __m128i premultiplySSE2(__m128i c) {
+  const auto alphaLanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+  const auto opaque     = _mm_set1_epi16(255);
+
+  auto a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, 0xff), 0xff);
+  a      = _mm_or_si128(_mm_andnot_si128(alphaLanes, a),
+                   _mm_and_si128(alphaLanes, opaque));
+
+  auto t = _mm_add_epi16(_mm_mullo_epi16(c, a), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+S25_TARGET("ssse3")
+void convertSSSE3(uint8_t *dst, const uint8_t *src, size_t n,
+                  unsigned conversions) {
+  auto swizzle     = (conversions & kS25ConvertSwizzleRGBA) != 0;
+  auto premultiply = (conversions & kS25ConvertPremultiply) != 0;
+
+  const auto swizzleMask =
+      _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const auto zero = _mm_setzero_si128();
+
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+
+    if (swizzle) {
+      v = _mm_shuffle_epi8(v, swizzleMask);
+    }
+
+    if (premultiply) {
+      auto lo = premultiplySSE2(_mm_unpacklo_epi8(v, zero));
+      auto hi = premultiplySSE2(_mm_unpackhi_epi8(v, zero));
+      v       = _mm_packus_epi16(lo, hi);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), v);
+  }
+
+  convertScalar(dst + i * 4, src + i * 4, n - i, conversions);
+}
+
+S25_TARGET("avx2")
+inline __m256i premultiplyAVX2(__m256i c) {
+  auto a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c, 0xff), 0xff);
+  a      = _mm256_blend_epi16(a, _mm256_set1_epi16(255), 0x88);
+
+  auto t = _mm256_add_epi16(_mm256_mullo_epi16(c, a), _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+S25_TARGET("avx2")
+void convertAVX2(uint8_t *dst, const uint8_t *src, size_t n,
+                 unsigned conversions) {
+  auto swizzle     = (conversions & kS25ConvertSwizzleRGBA) != 0;
+  auto premultiply = (conversions & kS25ConvertPremultiply) != 0;
+
+  const auto swizzleMask = _mm256_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, //
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const auto zero = _mm256_setzero_si256();
+
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    auto v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+
+    if (swizzle) {
+      v = _mm256_shuffle_epi8(v, swizzleMask);
+    }
+
+    // unpack and pack work per 128-bit lane, so pixel order is preserved
+    if (premultiply) {
+      auto lo = premultiplyAVX2(_mm256_unpacklo_epi8(v, zero));
+      auto hi = premultiplyAVX2(_mm256_unpackhi_epi8(v, zero));
+      v       = _mm256_packus_epi16(lo, hi);
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), v);
+  }
+
+  convertScalar(dst + i * 4, src + i * 4, n - i, conversions);
+}
+
+S25_TARGET("avx2")
+void alphaExtentAVX2(const uint8_t *row, int begin, int end, int *first,
+                     int *last) {
+  const auto alphaMask = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+
+  // skip fully transparent blocks of 8 pixels from both ends
+  auto x1 = begin;
+  while (x1 + 8 <= end) {
+    auto v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x1 * 4));
+    if (!_mm256_testz_si256(v, alphaMask)) {
+      break;
+    }
+
+    x1 += 8;
+  }
+
+  auto x2 = end;
+  while (x2 - 8 >= x1) {
+    auto v = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(row + (x2 - 8) * 4));
+    if (!_mm256_testz_si256(v, alphaMask)) {
+      break;
+    }
+
+    x2 -= 8;
+  }
+
+  alphaExtentScalar(row, x1, x2, first, last);
+}
+
+bool cpuHasSSSE3() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 9)) != 0;
+#else
+  return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+
+  // the OS must save the YMM registers
+  __cpuid(info, 1);
+  if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) ||
+      (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(S25_PIXEL_NEON)
+
+void convertNEON(uint8_t *dst, const uint8_t *src, size_t n,
+                 unsigned conversions) {
+  auto swizzle     = (conversions & kS25ConvertSwizzleRGBA) != 0;
+  auto premultiply = (conversions & kS25ConvertPremultiply) != 0;
+
+  // c * a / 255 on 8 lanes
+  auto multiply = [](uint8x8_t c, uint8x8_t a) {
+    auto t = vaddq_u16(vmull_u8(c, a), vdupq_n_u16(128));
+    return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+  };
+
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    // de-interleaved planes: val[0..3] = channels 0..3 of 16 pixels
+    auto v = vld4q_u8(src + i * 4);
+
+    if (swizzle) {
+      auto t   = v.val[0];
+      v.val[0] = v.val[2];
+      v.val[2] = t;
+    }
+
+    if (premultiply) {
+      auto a = v.val[3];
+
+      for (int c = 0; c < 3; c++) {
+        v.val[c] =
+            vcombine_u8(multiply(vget_low_u8(v.val[c]), vget_low_u8(a)),
+                        multiply(vget_high_u8(v.val[c]), vget_high_u8(a)));
+      }
+    }
+
+    vst4q_u8(dst + i * 4, v);
+  }
+
+  convertScalar(dst + i * 4, src + i * 4, n - i, conversions);
+}
+
+#endif
+
+struct Kernels {
+  const char *name;
+  void (*convert)(uint8_t *, const uint8_t *, size_t, unsigned);
+  void (*alphaExtent)(const uint8_t *, int, int, int *, int *);
+};
+
+// every set the running CPU supports, fastest first
+std::vector<Kernels> selectKernelSets() {
+  std::vector<Kernels> sets;
+
+#if defined(S25_PIXEL_X86)
+  if (cpuHasAVX2()) {
+    sets.push_back(Kernels{"avx2", convertAVX2, alphaExtentAVX2});
+  }
+
+  if (cpuHasSSSE3()) {
+    sets.push_back(Kernels{"ssse3", convertSSSE3, alphaExtentScalar});
+  }
+#elif defined(S25_PIXEL_NEON)
+  sets.push_back(Kernels{"neon", convertNEON, alphaExtentScalar});
+#endif
+
+  sets.push_back(Kernels{"scalar", convertScalar, alphaExtentScalar});
+  return sets;
+}
+
+std::vector<Kernels> const &getKernelSets() {
+  static const std::vector<Kernels> sets = selectKernelSets();
+  return sets;
+}
+
+// the set in use; an out of range `set` picks the scalar one
+Kernels const &getKernels(size_t set = 0) {
+  auto const &sets = getKernelSets();
+  return sets[std::min(set, sets.size() - 1)];
+}
+
+// reciprocals for unpremultiplication: c * 255 / a == (c * r[a]) >> 16
+struct UnpremultiplyTable {
+  uint32_t reciprocal[256];
+
+  UnpremultiplyTable() {
+    reciprocal[0] = 0;
+
+    for (uint32_t a = 1; a < 256; a++) {
+      reciprocal[a] = (255u * 65536u + a / 2) / a;
+    }
+  }
+};
+
+struct SRGBTable {
+  float   toLinear[256];
+  uint8_t fromLinear[4096]; // indexed by linear * 4095
+
+  SRGBTable() {
+    for (int i = 0; i < 256; i++) {
+      auto c      = i / 255.0;
+      toLinear[i] = static_cast<float>(
+          c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+    }
+
+    for (int i = 0; i < 4096; i++) {
+      auto l = i / 4095.0;
+      auto c =
+          l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1 / 2.4) - 0.055;
+
+      fromLinear[i] = static_cast<uint8_t>(std::lround(c * 255.0));
+    }
+  }
+};
+
+} // namespace
+
+void S25ConvertPixels(uint8_t *dst, const uint8_t *src, size_t pixelCount,
+                      unsigned conversions) {
+  if (conversions == kS25ConvertNone) {
+    if (dst != src) {
+      std::memcpy(dst, src, pixelCount * 4);
+    }
+
+    return;
+  }
+
+  getKernels().convert(dst, src, pixelCount, conversions);
+}
+
+void S25ConvertPixelsUsing(size_t set, uint8_t *dst, const uint8_t *src,
+                           size_t pixelCount, unsigned conversions) {
+  getKernels(set).convert(dst, src, pixelCount, conversions);
+}
+
+void S25UnpremultiplyPixels(uint8_t *dst, const uint8_t *src,
+                            size_t pixelCount) {
+  static const UnpremultiplyTable table;
+
+  for (size_t i = 0; i < pixelCount; i++, src += 4, dst += 4) {
+    uint32_t a = src[3];
+    auto     r = table.reciprocal[a];
+
+    for (int c = 0; c < 3; c++) {
+      dst[c] = static_cast<uint8_t>(
+          std::min<uint32_t>(255, (src[c] * r + 32768) >> 16));
+    }
+
+    dst[3] = static_cast<uint8_t>(a);
+  }
+}
+
+void S25SRGBToLinear(float *dst, const uint8_t *src, size_t pixelCount) {
+  static const SRGBTable table;
+
+  for (size_t i = 0; i < pixelCount; i++, src += 4, dst += 4) {
+    dst[0] = table.toLinear[src[0]];
+    dst[1] = table.toLinear[src[1]];
+    dst[2] = table.toLinear[src[2]];
+    dst[3] = src[3] * (1.0f / 255.0f);
+  }
+}
+
+void S25LinearToSRGB(uint8_t *dst, const float *src, size_t pixelCount) {
+  static const SRGBTable table;
+
+  auto index = [](float v) {
+    return static_cast<int>(std::min(std::max(v, 0.0f), 1.0f) * 4095.0f + 0.5f);
+  };
+
+  for (size_t i = 0; i < pixelCount; i++, src += 4, dst += 4) {
+    dst[0] = table.fromLinear[index(src[0])];
+    dst[1] = table.fromLinear[index(src[1])];
+    dst[2] = table.fromLinear[index(src[2])];
+    // alpha is linear; rounded directly so that every 8-bit value survives
+    // S25SRGBToLinear and back
+    dst[3] = static_cast<uint8_t>(
+        std::lround(std::min(std::max(src[3], 0.0f), 1.0f) * 255.0f));
+  }
+}
+
+S25AlphaBounds S25GetAlphaBounds(const uint8_t *bgra, int width, int height) {
+  return S25GetAlphaBoundsUsing(0, bgra, width, height);
+}
+
+S25AlphaBounds S25GetAlphaBoundsUsing(size_t set, const uint8_t *bgra,
+                                      int width, int height) {
+  auto const &kernels = getKernels(set);
+
+  int x1 = width;
+  int x2 = -1;
+  int y1 = -1;
+  int y2 = -1;
+
+  for (int y = 0; y < height; y++) {
+    auto row = bgra + static_cast<size_t>(y) * width * 4;
+
+    int first, last;
+    kernels.alphaExtent(row, 0, width, &first, &last);
+
+    if (first == -1) {
+      continue;
+    }
+
+    if (y1 == -1) {
+      y1 = y;
+    }
+
+    y2 = y;
+    x1 = std::min(x1, first);
+    x2 = std::max(x2, last);
+  }
+
+  if (y1 == -1) {
+    return S25AlphaBounds{0, 0, 0, 0};
+  }
+
+  return S25AlphaBounds{x1, y1, x2 - x1 + 1, y2 - y1 + 1};
+}
+
+const char *S25GetPixelKernelName() { return getKernels().name; }
+
+size_t S25GetPixelKernelSetCount() { return getKernelSets().size(); }
+
+const char *S25GetPixelKernelSetName(size_t set) {
+  return getKernels(set).name;
+}
+
+bool S25CpuHasAVX2() {
+#if defined(S25_PIXEL_X86)
+  return cpuHasAVX2();
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,60 @@
+#ifndef S25PIXELFORMAT_H
+#define S25PIXELFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Conversion kernels for the straight-alpha BGRA buffers of S25pImage.
+//
+// All functions take `pixelCount` 32-bit pixels and may run in place
+// (`dst == src`).  The fastest kernel set supported by the running CPU is
+// picked on first use.
+
+enum S25PixelConversion : unsigned {
+  kS25ConvertNone        = 0,
+  kS25ConvertSwizzleRGBA = 1 << 0, // BGRA <-> RGBA
+  kS25ConvertPremultiply = 1 << 1,
+};
+
+// applies `conversions` (swizzle first, then premultiply) in a single pass
+void S25ConvertPixels(uint8_t *dst, const uint8_t *src, size_t pixelCount,
+                      unsigned conversions);
+
+// premultiplied to straight alpha; colour channels are kept in place
+void S25UnpremultiplyPixels(uint8_t *dst, const uint8_t *src,
+                            size_t pixelCount);
+
+// sRGB encoded 8-bit pixels to linear floats (4 per pixel, 0..1) and back;
+// alpha is linear in both representations
+void S25SRGBToLinear(float *dst, const uint8_t *src, size_t pixelCount);
+void S25LinearToSRGB(uint8_t *dst, const float *src, size_t pixelCount);
+
+// smallest rectangle holding every pixel with non-zero alpha; all zero if
+// the image is fully transparent
+struct S25AlphaBounds {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+S25AlphaBounds S25GetAlphaBounds(const uint8_t *bgra, int width, int height);
+
+// name of the kernel set in use: "avx2", "ssse3", "neon" or "scalar"
+const char *S25GetPixelKernelName();
+
+// whether the running CPU and OS support AVX2; always false off x86
+bool S25CpuHasAVX2();
+
+// For the kernel check: the kernel sets the running CPU supports, the one in
+// use first and "scalar" last, and the kernels above run through one of them
+// (an out of range `set` picks the scalar one).
+size_t         S25GetPixelKernelSetCount();
+const char *   S25GetPixelKernelSetName(size_t set);
+void           S25ConvertPixelsUsing(size_t set, uint8_t *dst,
+                                     const uint8_t *src, size_t pixelCount,
+                                     unsigned conversions);
+S25AlphaBounds S25GetAlphaBoundsUsing(size_t set, const uint8_t *bgra,
+                                      int width, int height);
+
+#endif // S25PIXELFORMAT_H
@@ -0,0 +1,236 @@
+#include "S25ProgramCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QOpenGLExtraFunctions>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+// bumped whenever the layout of the cache files changes
+constexpr quint32 kCacheFileVersion = 1;
+
+// file header: version, binary format
+constexpr int kHeaderSize = 2 * sizeof(quint32);
+
+bool programBinariesSupported() {
+  auto context = QOpenGLContext::currentContext();
+  auto version = context->format().version();
+
+  if (context->isOpenGLES()) {
+    if (version < qMakePair(3, 0)) {
+      return false;
+    }
+  } else if (version < qMakePair(4, 1) &&
+             !context->hasExtension("GL_ARB_get_program_binary")) {
+    return false;
+  }
+
+  // drivers may support the API without offering any binary format
+  GLint formats = 0;
+  context->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+  return formats > 0;
+}
+
+QString cacheFilePath(const char *vertSource, const char *fragSource) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  // a driver update invalidates the binaries it produced
+  for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    auto value = reinterpret_cast<const char *>(f->glGetString(name));
+
+    hash.addData(QByteArray(value));
+    hash.addData(QByteArray("\n"));
+  }
+
+  hash.addData(QByteArray(vertSource));
+  hash.addData(QByteArray("\n"));
+  hash.addData(QByteArray(fragSource));
+
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         "/programs/" + QString::fromLatin1(hash.result().toHex()) + ".bin";
+}
+
+GLuint loadBinary(QOpenGLExtraFunctions *f, QString const &path) {
+  QFile file(path);
+
+  if (!file.open(QIODevice::ReadOnly)) {
+    return 0;
+  }
+
+  auto data = file.readAll();
+  file.close();
+
+  if (data.size() <= kHeaderSize) {
+    return 0;
+  }
+
+  quint32 header[2];
+  std::memcpy(header, data.constData(), kHeaderSize);
+
+  if (header[0] != kCacheFileVersion) {
+    return 0;
+  }
+
+  auto program = f->glCreateProgram();
+  f->glProgramBinary(program, header[1], data.constData() + kHeaderSize,
+                     data.size() - kHeaderSize);
+
+  GLint linked = GL_FALSE;
+  f->glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+  if (!linked) {
+    // rejected by the driver; recompile and overwrite it
+    f->glDeleteProgram(program);
+    QFile::remove(path);
+    return 0;
+  }
+
+  return program;
+}
+
+void storeBinary(QOpenGLExtraFunctions *f, GLuint program,
+                 QString const &path) {
+  GLint length = 0;
+  f->glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+  if (length <= 0) {
+    return;
+  }
+
+  QByteArray data(kHeaderSize + length, Qt::Uninitialized);
+  GLenum     format = 0;
+
+  f->glGetProgramBinary(program, length, &length, &format,
+                        data.data() + kHeaderSize);
+
+  if (length <= 0) {
+    return;
+  }
+
+  quint32 header[2] = {kCacheFileVersion, format};
+  std::memcpy(data.data(), header, kHeaderSize);
+  data.resize(kHeaderSize + length);
+
+  QDir().mkpath(QFileInfo(path).absolutePath());
+
+  // written atomically, so that concurrent launches never see half a file
+  QSaveFile file(path);
+
+  if (file.open(QIODevice::WriteOnly)) {
+    file.write(data);
+    file.commit();
+  }
+}
+
+GLuint compileShader(QOpenGLExtraFunctions *f, GLenum type,
+                     const char *source) {
+  auto shader = f->glCreateShader(type);
+
+  f->glShaderSource(shader, 1, &source, nullptr);
+  f->glCompileShader(shader);
+
+  GLint compiled = GL_FALSE;
+  f->glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+  if (!compiled) {
+    // the info log is only fetched when something went wrong
+    GLint length = 0;
+    f->glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+
+    std::vector<char> log(std::max(length, 1), 0);
+    f->glGetShaderInfoLog(shader, log.size(), nullptr, log.data());
+    qWarning("shader compilation failed: %s", log.data());
+
+    f->glDeleteShader(shader);
+    return 0;
+  }
+
+  return shader;
+}
+
+GLuint linkFromSource(QOpenGLExtraFunctions *f, const char *vertSource,
+                      const char *fragSource, bool retrievable) {
+  auto vShader = compileShader(f, GL_VERTEX_SHADER, vertSource);
+  auto fShader = compileShader(f, GL_FRAGMENT_SHADER, fragSource);
+
+  if (!vShader || !fShader) {
+    f->glDeleteShader(vShader);
+    f->glDeleteShader(fShader);
+    return 0;
+  }
+
+  auto program = f->glCreateProgram();
+
+  if (retrievable) {
+    f->glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                           GL_TRUE);
+  }
+
+  f->glAttachShader(program, vShader);
+  f->glAttachShader(program, fShader);
+  f->glLinkProgram(program);
+
+  f->glDeleteShader(vShader);
+  f->glDeleteShader(fShader);
+
+  GLint linked = GL_FALSE;
+  f->glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+  if (!linked) {
+    GLint length = 0;
+    f->glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+
+    std::vector<char> log(std::max(length, 1), 0);
+    f->glGetProgramInfoLog(program, log.size(), nullptr, log.data());
+    qWarning("program link failed: %s", log.data());
+
+    f->glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
+}
+
+} // namespace
+
+GLuint S25LinkProgram(const char *vertSource, const char *fragSource,
+                      bool *fromCache) {
+  auto f = QOpenGLContext::currentContext()->extraFunctions();
+
+  if (fromCache) {
+    *fromCache = false;
+  }
+
+  if (!programBinariesSupported()) {
+    return linkFromSource(f, vertSource, fragSource, false);
+  }
+
+  auto path = cacheFilePath(vertSource, fragSource);
+
+  if (auto program = loadBinary(f, path)) {
+    if (fromCache) {
+      *fromCache = true;
+    }
+
+    return program;
+  }
+
+  auto program = linkFromSource(f, vertSource, fragSource, true);
+
+  if (program) {
+    storeBinary(f, program, path);
+  }
+
+  return program;
+}
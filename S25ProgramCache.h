@@ -0,0 +1,15 @@
+#ifndef S25PROGRAMCACHE_H
+#define S25PROGRAMCACHE_H
+
+#include <QOpenGLContext>
+
+// Links a program from GLSL sources in the current context.  The linked
+// binary is stored under the user's cache directory, keyed by the driver's
+// vendor, renderer and version strings and by the sources, and is loaded
+// instead of compiling on later launches.  A missing, stale or rejected
+// binary falls back to compiling from source.  Returns 0 when compiling or
+// linking fails; `fromCache` reports whether the binary was reused.
+GLuint S25LinkProgram(const char *vertSource, const char *fragSource,
+                      bool *fromCache = nullptr);
+
+#endif // S25PROGRAMCACHE_H
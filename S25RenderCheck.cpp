@@ -0,0 +1,617 @@
+#include "S25RenderCheck.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+#include <QOpenGLFramebufferObject>
+#else
+#include <QtOpenGL/QOpenGLFramebufferObject>
+#endif
+
+#include "S25ArchiveSession.h"
+#include "S25Composite.h"
+#include "S25Renderer.h"
+#include "S25Resample.h"
+
+namespace {
+
+// largest per-channel difference accepted; GL rounds to 8 bits after every
+// blended layer, the CPU composite rounds in straight alpha
+constexpr int kTolerance = 4;
+
+// framebuffer margin and offset of the panned frame, in pixels
+constexpr int kPanX = 17;
+constexpr int kPanY = 9;
+
+constexpr int kTimedFrames = 60;
+
+// magnification of the zoomed comparison; the synthetic layers have even
+// sizes and offsets, so that they also halve exactly
+constexpr int    kZoom        = 2;
+constexpr double kReducedZoom = 0.5;
+
+struct Difference {
+  int    maxDiff;
+  size_t mismatches;
+};
+
+// selects the first pict layer that decodes in every layer; false if the
+// archive has nothing to show
+bool selectFirstPictLayers(S25ArchiveSession &session) {
+  auto total = session.archive.getTotalEntries();
+  bool found = false;
+
+  for (size_t i = 0; i < session.imageEntries.size(); i++) {
+    session.imageEntries[i] = -1;
+
+    for (size_t j = 0; j < 100 && j + 100 * i < total; j++) {
+      if (session.cache.getImage(session.reader, j + 100 * i)) {
+        session.imageEntries[i] = j;
+        found                   = true;
+        break;
+      }
+    }
+  }
+
+  return found;
+}
+
+// moves one layer to its next valid pict layer, as S25LayerModel would;
+// returns that layer, or -1
+long advancePictLayer(S25ArchiveSession &session) {
+  auto total = session.archive.getTotalEntries();
+
+  for (size_t i = 0; i < session.imageEntries.size(); i++) {
+    if (session.imageEntries[i] == -1) {
+      continue;
+    }
+
+    for (size_t j = session.imageEntries[i] + 1;
+         j < 100 && j + 100 * i < total; j++) {
+      if (session.cache.getImage(session.reader, j + 100 * i)) {
+        session.imageEntries[i] = j;
+        return i;
+      }
+    }
+  }
+
+  return -1;
+}
+
+void loadSession(S25Renderer &renderer, S25ArchiveSession &session,
+                 double textureScale) {
+  QElapsedTimer timer;
+  timer.start();
+
+  renderer.loadLayers(session, textureScale);
+  renderer.loadVertexBuffers(session);
+
+  auto timings = renderer.getTimings();
+  auto totalNs = timer.nsecsElapsed();
+
+  qInfo("load at %.3gx: decode %.2f ms, upload %.2f ms (%.1f MiB)",
+        textureScale, timings.decodeNs / 1e6,
+        (totalNs - timings.decodeNs) / 1e6,
+        timings.uploadBytes / (1024.0 * 1024.0));
+}
+
+// maps the composite bounds onto the framebuffer at (dx, dy), scaled by
+// `scale` around the centre of the canvas
+QTransform getCanvasTransform(S25ArchiveSession const & session,
+                              S25CompositeBounds const &bounds,
+                              QSize const &framebuffer, double dx, double dy,
+                              double scale) {
+  auto origin  = S25Renderer::getOrigin(session);
+  auto centreX = bounds.x - origin.x() + bounds.width * 0.5;
+  auto centreY = bounds.y - origin.y() + bounds.height * 0.5;
+
+  return QTransform()
+      .translate(-1, 1)
+      .scale(2.0 / framebuffer.width(), -2.0 / framebuffer.height())
+      .translate(dx + bounds.width * 0.5, dy + bounds.height * 0.5)
+      .scale(scale, scale)
+      .translate(-centreX, -centreY);
+}
+
+// renders over opaque black and reads back RGBA rows, bottom row first
+std::vector<uint8_t> renderFrame(S25Renderer &renderer,
+                                 S25ArchiveSession &session,
+                                 QOpenGLFramebufferObject &framebuffer,
+                                 QTransform const &transform) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  framebuffer.bind();
+
+  f->glViewport(0, 0, framebuffer.width(), framebuffer.height());
+  f->glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  f->glClear(GL_COLOR_BUFFER_BIT);
+
+  renderer.paint(session, transform);
+
+  std::vector<uint8_t> pixels(static_cast<size_t>(framebuffer.width()) *
+                              framebuffer.height() * 4);
+
+  f->glReadPixels(0, 0, framebuffer.width(), framebuffer.height(), GL_RGBA,
+                  GL_UNSIGNED_BYTE, pixels.data());
+
+  framebuffer.release();
+
+  return pixels;
+}
+
+// compares the colour of the frame at (dx, dy) with `reference` (straight
+// alpha) composited over black
+Difference compareToReference(std::vector<uint8_t> const &pixels,
+                              QSize const &framebuffer,
+                              S25pImage const &reference, int dx, int dy) {
+  auto ref = reference.getBGRABuffer(nullptr);
+
+  Difference difference{0, 0};
+
+  for (int y = 0; y < reference.getHeight(); y++) {
+    auto row = framebuffer.height() - 1 - (y + dy);
+    auto dst = pixels.data() +
+               (static_cast<size_t>(row) * framebuffer.width() + dx) * 4;
+    auto src = ref + static_cast<size_t>(y) * reference.getWidth() * 4;
+
+    for (int x = 0; x < reference.getWidth(); x++) {
+      auto const *s = src + x * 4;
+      auto const *d = dst + x * 4;
+
+      int a = s[3];
+
+      int expected[3] = {
+          (s[2] * a + 127) / 255,
+          (s[1] * a + 127) / 255,
+          (s[0] * a + 127) / 255,
+      };
+
+      int diff = 0;
+
+      for (int c = 0; c < 3; c++) {
+        diff = std::max(diff, std::abs(d[c] - expected[c]));
+      }
+
+      difference.maxDiff = std::max(difference.maxDiff, diff);
+
+      if (diff > kTolerance) {
+        difference.mismatches++;
+      }
+    }
+  }
+
+  return difference;
+}
+
+// renders at 1:1 (at the origin and panned) and compares with S25Composite
+bool checkFrames(S25Renderer &renderer, S25ArchiveSession &session,
+                 const char *label) {
+  auto reference = S25Composite(session.images);
+  auto bounds    = S25GetCompositeBounds(session.images);
+
+  auto size = QSize(bounds.width + kPanX, bounds.height + kPanY);
+
+  QOpenGLFramebufferObject framebuffer(
+      size, QOpenGLFramebufferObject::NoAttachment, GL_TEXTURE_2D, GL_RGBA8);
+
+  if (!framebuffer.isValid()) {
+    qCritical("%s: failed to create a %dx%d framebuffer", label, size.width(),
+              size.height());
+    return false;
+  }
+
+  bool passed = true;
+
+  for (auto pan : {QPoint(0, 0), QPoint(kPanX, kPanY)}) {
+    auto transform =
+        getCanvasTransform(session, bounds, size, pan.x(), pan.y(), 1.0);
+    auto pixels = renderFrame(renderer, session, framebuffer, transform);
+    auto diff = compareToReference(pixels, size, reference, pan.x(), pan.y());
+
+    qInfo("%s, pan (%d, %d): max difference %d, %zu pixels over %d", label,
+          pan.x(), pan.y(), diff.maxDiff, diff.mismatches, kTolerance);
+
+    passed = passed && diff.mismatches == 0;
+  }
+
+  return passed;
+}
+
+// maps the composite bounds onto a framebuffer of `scale` times their size,
+// with the corner of the canvas at the corner of the framebuffer
+QTransform getScaledCanvasTransform(S25ArchiveSession const & session,
+                                    S25CompositeBounds const &bounds,
+                                    QSize const &framebuffer, double scale) {
+  return getCanvasTransform(session, bounds, framebuffer,
+                            (scale - 1) * bounds.width * 0.5,
+                            (scale - 1) * bounds.height * 0.5, scale);
+}
+
+// Colour over black of the layers magnified kZoom times, each sampled
+// bilinearly in straight alpha and clamped at its edges, like GL_LINEAR
+// does.  Pixels that sample across the edge of a layer are left out: the
+// cached composites filter across it where the layers themselves clamp.
+struct ZoomedReference {
+  std::vector<float> colour; // RGB
+  std::vector<bool>  compared;
+};
+
+ZoomedReference makeZoomedReference(S25ArchiveSession const & session,
+                                    S25CompositeBounds const &bounds,
+                                    QSize const &              size) {
+  auto pixels = static_cast<size_t>(size.width()) * size.height();
+
+  ZoomedReference reference{std::vector<float>(pixels * 3, 0.0f),
+                            std::vector<bool>(pixels, true)};
+
+  for (auto const &image : session.images) {
+    if (!image) {
+      continue;
+    }
+
+    auto width  = image->getWidth();
+    auto height = image->getHeight();
+    auto left   = image->getOffsetX() - bounds.x;
+    auto top    = image->getOffsetY() - bounds.y;
+    auto data   = image->getBGRABuffer(nullptr);
+
+    auto texel = [&](int x, int y) {
+      x = std::min(std::max(x, 0), width - 1);
+      y = std::min(std::max(y, 0), height - 1);
+      return data + (static_cast<size_t>(y) * width + x) * 4;
+    };
+
+    for (int py = 0; py < size.height(); py++) {
+      for (int px = 0; px < size.width(); px++) {
+        // texel space of the layer, texel centres at whole numbers
+        auto u = (px + 0.5) / kZoom - left - 0.5;
+        auto v = (py + 0.5) / kZoom - top - 0.5;
+        auto i = static_cast<size_t>(py) * size.width() + px;
+
+        if (u <= -1 || v <= -1 || u >= width || v >= height) {
+          continue;
+        }
+
+        if (u < 0 || v < 0 || u > width - 1 || v > height - 1) {
+          reference.compared[i] = false;
+          continue;
+        }
+
+        auto x  = static_cast<int>(u);
+        auto y  = static_cast<int>(v);
+        auto fx = u - x;
+        auto fy = v - y;
+
+        auto p00 = texel(x, y);
+        auto p10 = texel(x + 1, y);
+        auto p01 = texel(x, y + 1);
+        auto p11 = texel(x + 1, y + 1);
+
+        auto sample = [&](int c) {
+          return (1 - fy) * ((1 - fx) * p00[c] + fx * p10[c]) +
+                 fy * ((1 - fx) * p01[c] + fx * p11[c]);
+        };
+
+        auto a   = sample(3) / 255.0;
+        auto out = &reference.colour[i * 3];
+
+        // RGB from BGRA
+        for (int c = 0; c < 3; c++) {
+          out[c] = static_cast<float>(out[c] * (1 - a) + sample(2 - c) * a);
+        }
+      }
+    }
+  }
+
+  return reference;
+}
+
+// renders magnified kZoom times and compares with makeZoomedReference()
+bool checkZoomedFrame(S25Renderer &renderer, S25ArchiveSession &session,
+                      const char *label) {
+  auto bounds = S25GetCompositeBounds(session.images);
+  auto size   = QSize(bounds.width * kZoom, bounds.height * kZoom);
+
+  QOpenGLFramebufferObject framebuffer(
+      size, QOpenGLFramebufferObject::NoAttachment, GL_TEXTURE_2D, GL_RGBA8);
+
+  if (!framebuffer.isValid()) {
+    qCritical("%s: failed to create a %dx%d framebuffer", label, size.width(),
+              size.height());
+    return false;
+  }
+
+  auto transform = getScaledCanvasTransform(session, bounds, size, kZoom);
+  auto pixels    = renderFrame(renderer, session, framebuffer, transform);
+  auto reference = makeZoomedReference(session, bounds, size);
+
+  Difference difference{0, 0};
+  size_t     compared = 0;
+
+  for (int y = 0; y < size.height(); y++) {
+    auto row = pixels.data() +
+               static_cast<size_t>(size.height() - 1 - y) * size.width() * 4;
+
+    for (int x = 0; x < size.width(); x++) {
+      auto i = static_cast<size_t>(y) * size.width() + x;
+
+      if (!reference.compared[i]) {
+        continue;
+      }
+
+      int diff = 0;
+
+      for (int c = 0; c < 3; c++) {
+        auto expected = static_cast<int>(reference.colour[i * 3 + c] + 0.5f);
+        diff          = std::max(diff, std::abs(row[x * 4 + c] - expected));
+      }
+
+      compared++;
+      difference.maxDiff = std::max(difference.maxDiff, diff);
+
+      if (diff > kTolerance) {
+        difference.mismatches++;
+      }
+    }
+  }
+
+  qInfo("%s, %dx zoom: max difference %d, %zu of %zu pixels over %d", label,
+        kZoom, difference.maxDiff, difference.mismatches, compared,
+        kTolerance);
+
+  return difference.mismatches == 0;
+}
+
+// uploads reduced textures, as the zoomed-out viewer does, and compares a
+// frame at that scale with the composite of the same Lanczos-reduced layers
+bool checkReducedFrame(S25Renderer &renderer, S25ArchiveSession &session,
+                       const char *label) {
+  std::vector<std::shared_ptr<const S25pImage>> reduced;
+
+  for (auto const &image : session.images) {
+    if (!image) {
+      reduced.push_back(nullptr);
+      continue;
+    }
+
+    reduced.push_back(std::make_shared<const S25pImage>(S25Resample(
+        *image, static_cast<int>(image->getWidth() * kReducedZoom),
+        static_cast<int>(image->getHeight() * kReducedZoom),
+        S25ResampleFilter::kLanczos3)));
+  }
+
+  renderer.uploadLayers(session, kReducedZoom);
+  renderer.loadVertexBuffers(session);
+
+  auto reference = S25Composite(reduced);
+  auto bounds    = S25GetCompositeBounds(session.images);
+  auto size      = QSize(reference.getWidth(), reference.getHeight());
+
+  QOpenGLFramebufferObject framebuffer(
+      size, QOpenGLFramebufferObject::NoAttachment, GL_TEXTURE_2D, GL_RGBA8);
+
+  if (!framebuffer.isValid()) {
+    qCritical("%s: failed to create a %dx%d framebuffer", label, size.width(),
+              size.height());
+    return false;
+  }
+
+  auto transform =
+      getScaledCanvasTransform(session, bounds, size, kReducedZoom);
+  auto pixels = renderFrame(renderer, session, framebuffer, transform);
+  auto diff   = compareToReference(pixels, size, reference, 0, 0);
+
+  qInfo("%s, %.3gx textures: max difference %d, %zu pixels over %d", label,
+        kReducedZoom, diff.maxDiff, diff.mismatches, kTolerance);
+
+  return diff.mismatches == 0;
+}
+
+// renders panned frames at `scale` and prints the frame times
+void timeFrames(S25Renderer &renderer, S25ArchiveSession &session,
+                double scale) {
+  auto bounds = S25GetCompositeBounds(session.images);
+  auto size   = QSize(bounds.width, bounds.height);
+
+  QOpenGLFramebufferObject framebuffer(
+      size, QOpenGLFramebufferObject::NoAttachment, GL_TEXTURE_2D, GL_RGBA8);
+
+  std::vector<double> frameMs;
+
+  for (int i = 0; i < kTimedFrames; i++) {
+    auto transform = getCanvasTransform(session, bounds, size, i % kPanX,
+                                        i % kPanY, scale);
+
+    renderFrame(renderer, session, framebuffer, transform);
+    frameMs.push_back(renderer.getTimings().frameNs / 1e6);
+  }
+
+  std::sort(frameMs.begin(), frameMs.end());
+
+  double total = 0;
+
+  for (auto ms : frameMs) {
+    total += ms;
+  }
+
+  auto p95 = frameMs[static_cast<size_t>(0.95 * (frameMs.size() - 1) + 0.5)];
+
+  qInfo("frames at %.3gx: mean %.2f ms, p95 %.2f ms, max %.2f ms", scale,
+        total / frameMs.size(), p95, frameMs.back());
+}
+
+// Layer built in memory, in the straight BGRA of the decoder.  Opaque
+// layers are a colour gradient; the others ramp alpha across the layer,
+// with every fifth column fully transparent.
+std::shared_ptr<const S25pImage> makeLayer(int width, int height, int x, int y,
+                                           int seed, bool opaque) {
+  std::vector<uint8_t> buffer(static_cast<size_t>(width) * height * 4);
+
+  for (int py = 0; py < height; py++) {
+    for (int px = 0; px < width; px++) {
+      auto p = &buffer[(static_cast<size_t>(py) * width + px) * 4];
+
+      p[0] = static_cast<uint8_t>(px * 255 / width);
+      p[1] = static_cast<uint8_t>(py * 255 / height);
+      p[2] = static_cast<uint8_t>(seed * 67 + px + py);
+      p[3] = 255;
+
+      if (!opaque) {
+        p[3] = (px + seed) % 5 == 0
+                   ? 0
+                   : static_cast<uint8_t>((px * 255 / width + seed * 40) %
+                                          256);
+      }
+    }
+  }
+
+  return std::make_shared<const S25pImage>(width, height, x, y,
+                                           std::move(buffer));
+}
+
+void uploadSession(S25Renderer &renderer, S25ArchiveSession &session) {
+  renderer.uploadLayers(session);
+  renderer.loadVertexBuffers(session);
+}
+
+// Renders layers built in memory, so that the check runs without an
+// archive: an opaque background, two translucent layers (one partly off the
+// background) and an empty layer between them.  Then one layer is edited
+// while active and one of the cached layers changes.  Frames are compared
+// at 1:1, magnified (drawn directly and through the cached composites) and
+// zoomed out with reduced textures and composites.
+bool checkSyntheticLayers(S25Renderer &renderer) {
+  S25ArchiveSession session("synthetic", S25pSharedArchive());
+
+  session.images = {
+      makeLayer(96, 64, 0, 0, 0, true),
+      makeLayer(40, 30, 20, 10, 1, false),
+      nullptr,
+      makeLayer(50, 20, -8, 40, 2, false),
+  };
+
+  uploadSession(renderer, session);
+
+  auto passed = checkFrames(renderer, session, "synthetic layers");
+  passed = checkZoomedFrame(renderer, session, "synthetic layers") && passed;
+
+  renderer.setActiveLayer(1);
+
+  session.images[1] = makeLayer(44, 36, 16, 6, 3, false);
+  uploadSession(renderer, session);
+
+  passed = checkFrames(renderer, session, "active layer edited") && passed;
+  passed =
+      checkZoomedFrame(renderer, session, "active layer edited") && passed;
+
+  // the composite above the active layer has to be rebuilt
+  session.images[3] = makeLayer(30, 24, 60, 30, 4, false);
+  uploadSession(renderer, session);
+
+  passed = checkFrames(renderer, session, "cached layer changed") && passed;
+  passed =
+      checkReducedFrame(renderer, session, "cached layer changed") && passed;
+
+  renderer.setActiveLayer(-1);
+  renderer.releaseTextures(session);
+
+  return passed;
+}
+
+bool checkArchive(S25Renderer &renderer, QString const &path) {
+  auto archive = S25pSharedArchive(path.toUtf8());
+
+  if (!archive) {
+    qCritical("failed to open %s", qPrintable(path));
+    return false;
+  }
+
+  S25ArchiveSession session(path, std::move(archive));
+
+  if (!selectFirstPictLayers(session)) {
+    qCritical("%s has no decodable layers", qPrintable(path));
+    return false;
+  }
+
+  loadSession(renderer, session, 1.0);
+
+  auto passed = checkFrames(renderer, session, "first pict layers");
+
+  timeFrames(renderer, session, 1.0);
+
+  // edit one layer; the others are drawn from the cached composites
+  auto layer = advancePictLayer(session);
+
+  if (layer != -1) {
+    renderer.setActiveLayer(layer);
+
+    loadSession(renderer, session, 1.0);
+    passed = checkFrames(renderer, session, "pict layer changed") && passed;
+
+    timeFrames(renderer, session, 1.0);
+  }
+
+  timeFrames(renderer, session, 2.0);
+
+  // zoomed out, with reduced textures like the viewer uploads
+  loadSession(renderer, session, 0.5);
+  timeFrames(renderer, session, 0.5);
+
+  renderer.releaseTextures(session);
+
+  return passed;
+}
+
+} // namespace
+
+int S25RunRenderCheck(QString const &path) {
+  QOpenGLContext context;
+
+  if (!context.create()) {
+    qCritical("failed to create an OpenGL context");
+    return 1;
+  }
+
+  QOffscreenSurface surface;
+  surface.setFormat(context.format());
+  surface.create();
+
+  if (!context.makeCurrent(&surface)) {
+    qCritical("failed to make the OpenGL context current");
+    return 1;
+  }
+
+  auto f = context.functions();
+
+  qInfo("renderer: %s, %s",
+        reinterpret_cast<const char *>(f->glGetString(GL_RENDERER)),
+        reinterpret_cast<const char *>(f->glGetString(GL_VERSION)));
+
+  S25Renderer renderer;
+
+  if (!renderer.initialize()) {
+    qCritical("failed to build the shader program");
+    return 1;
+  }
+
+  renderer.createResources();
+
+  auto passed = path.isEmpty() ? checkSyntheticLayers(renderer)
+                               : checkArchive(renderer, path);
+
+  if (!passed) {
+    qCritical("render check failed");
+    return 1;
+  }
+
+  qInfo("render check passed");
+  return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef S25RENDERCHECK_H
+#define S25RENDERCHECK_H
+
+#include <QString>
+
+// Offscreen regression check of the GL render path
+// (`S25Viewer --render-check [archive]`).
+//
+// Renders the archive with S25Renderer into a framebuffer object on a
+// QOffscreenSurface, so it runs without a display or a GPU (e.g. with
+// QT_QPA_PLATFORM=offscreen on Mesa llvmpipe).  Frames are compared against
+// the CPU composite over opaque black at 1:1, after a pan and after changing
+// a pict layer (drawn through the cached composites around the active
+// layer); zoomed archive frames are rendered for timing only.  Upload and
+// frame timings are printed.  An empty `path` renders synthetic layers built
+// in memory instead (the ctest target), which are also compared magnified
+// against a bilinear reference and zoomed out with reduced textures.  Needs
+// a QGuiApplication; returns the process exit code, nonzero when a frame
+// does not match.
+int S25RunRenderCheck(QString const &path);
+
+#endif // S25RENDERCHECK_H
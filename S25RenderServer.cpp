@@ -0,0 +1,463 @@
+#include "S25RenderServer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTemporaryFile>
+
+#include "S25Composite.h"
+#include "S25PixelFormat.h"
+#include "S25Resample.h"
+
+namespace {
+
+QJsonObject makeError(QJsonValue const &id, QString const &message) {
+  return QJsonObject{{"id", id}, {"ok", false}, {"error", message}};
+}
+
+} // namespace
+
+S25RenderServer::S25RenderServer(QObject *parent)
+    : QObject(parent), m_server{}, m_archives{}, m_governor{},
+      m_latencies{}, m_requestCount{0}, m_failedCount{0} {
+  connect(&m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+S25RenderServer::~S25RenderServer() {
+  for (auto &client : m_segments) {
+    for (auto &segment : client.second) {
+      QFile::remove(segment.first);
+    }
+  }
+}
+
+bool S25RenderServer::listen(QString const &name) {
+  // a stale socket file is left behind if a previous server crashed
+  QLocalServer::removeServer(name);
+
+  return m_server.listen(name);
+}
+
+QString S25RenderServer::getErrorString() const {
+  return m_server.errorString();
+}
+
+void S25RenderServer::newConnection() {
+  while (auto client = m_server.nextPendingConnection()) {
+    m_segments[client] = Segments{};
+
+    connect(client, SIGNAL(readyRead()), this, SLOT(readyRead()));
+    connect(client, SIGNAL(disconnected()), this, SLOT(disconnected()));
+  }
+}
+
+void S25RenderServer::readyRead() {
+  auto client = qobject_cast<QLocalSocket *>(sender());
+  if (!client) {
+    return;
+  }
+
+  while (client->canReadLine()) {
+    auto line = client->readLine().trimmed();
+    if (line.isEmpty()) {
+      continue;
+    }
+
+    QJsonParseError error;
+    auto            doc = QJsonDocument::fromJson(line, &error);
+
+    QJsonObject reply;
+
+    if (!doc.isObject()) {
+      reply = makeError(QJsonValue{}, error.errorString());
+    } else {
+      reply = handleRequest(doc.object(), client);
+    }
+
+    client->write(QJsonDocument(reply).toJson(QJsonDocument::Compact));
+    client->write("\n");
+  }
+}
+
+void S25RenderServer::disconnected() {
+  auto client = qobject_cast<QLocalSocket *>(sender());
+  if (!client) {
+    return;
+  }
+
+  // buffers that were never released die with their client
+  auto segments = m_segments.find(client);
+  if (segments != m_segments.end()) {
+    for (auto &segment : segments->second) {
+      QFile::remove(segment.first);
+    }
+
+    m_segments.erase(segments);
+  }
+
+  client->deleteLater();
+}
+
+QJsonObject S25RenderServer::handleRequest(QJsonObject const &request,
+                                           QLocalSocket *     client) {
+  if (request.contains("requests")) {
+    QJsonArray results;
+
+    for (auto const &item : request["requests"].toArray()) {
+      results.append(render(item.toObject(), client));
+    }
+
+    return QJsonObject{{"results", results}};
+  }
+
+  if (request.contains("release")) {
+    releaseSegment(client, request["release"].toString());
+    return QJsonObject{{"ok", true}};
+  }
+
+  if (request.contains("stats")) {
+    return getStatistics();
+  }
+
+  return render(request, client);
+}
+
+QJsonObject S25RenderServer::render(QJsonObject const &request,
+                                    QLocalSocket *     client) {
+  QElapsedTimer timer;
+  timer.start();
+
+  auto id = request["id"];
+
+  S25ArchiveSession *session = nullptr;
+
+  auto reply = [&]() -> QJsonObject {
+    session = openArchive(request["archive"].toString());
+    if (!session) {
+      return makeError(id, "failed to open archive");
+    }
+
+    auto format     = request["format"].toString("bgra");
+    auto scale      = request["scale"].toDouble(1.0);
+    auto filterName = request["filter"].toString("lanczos");
+
+    if (format != "bgra" && format != "rgba" && format != "png") {
+      return makeError(id, "unknown format");
+    }
+
+    // raw output conversions, fused into a single in-place pass
+    unsigned conversions = kS25ConvertNone;
+
+    if (format == "rgba") {
+      conversions |= kS25ConvertSwizzleRGBA;
+    }
+
+    if (format != "png" && request["premultiplied"].toBool(false)) {
+      conversions |= kS25ConvertPremultiply;
+    }
+
+    S25ResampleFilter filter;
+
+    if (filterName == "box") {
+      filter = S25ResampleFilter::kBox;
+    } else if (filterName == "bilinear") {
+      filter = S25ResampleFilter::kBilinear;
+    } else if (filterName == "lanczos") {
+      filter = S25ResampleFilter::kLanczos3;
+    } else {
+      return makeError(id, "unknown filter");
+    }
+
+    if (scale <= 0.0 || scale > 1.0) {
+      return makeError(id, "scale must be in (0, 1]");
+    }
+
+    // decode (or fetch from the warm cache) the selected entries
+    auto           layers = request["layers"].toArray();
+    S25LayerImages images;
+
+    for (int i = 0; i < layers.size(); i++) {
+      auto pictLayer = layers.at(i).toInt(-1);
+
+      if (pictLayer == -1) {
+        continue;
+      }
+
+      // entries are numbered layer * 100 + pict layer
+      if (pictLayer < 0 || pictLayer > 99) {
+        return makeError(id, QString("pict layer %1 of layer %2 is out of "
+                                     "range [0, 99]")
+                                 .arg(pictLayer)
+                                 .arg(i));
+      }
+
+      auto image =
+          session->cache.getImage(session->reader, pictLayer + 100 * i);
+      if (!image) {
+        return makeError(id, QString("no entry for layer %1").arg(i));
+      }
+
+      images.push_back(std::move(image));
+    }
+
+    auto bounds = S25GetCompositeBounds(images);
+    if (bounds.width == 0 || bounds.height == 0) {
+      return makeError(id, "nothing to render");
+    }
+
+    QString path;
+    size_t  size   = 0;
+    int     width  = bounds.width;
+    int     height = bounds.height;
+
+    if (format != "png" && scale == 1.0) {
+      // composite straight into the shared buffer
+      size = static_cast<size_t>(width) * height * 4;
+      path = createSegment(client, size, [&](uchar *data) {
+        S25CompositeInto(data, bounds, images);
+        S25ConvertPixels(data, data, size / 4, conversions);
+      });
+    } else {
+      auto composite = S25Composite(images);
+
+      if (scale != 1.0) {
+        width  = std::max(1, static_cast<int>(width * scale + 0.5));
+        height = std::max(1, static_cast<int>(height * scale + 0.5));
+      }
+
+      if (format != "png") {
+        // resample straight into the shared buffer
+        size = static_cast<size_t>(width) * height * 4;
+        path = createSegment(client, size, [&](uchar *data) {
+          S25ResampleInto(composite.getBGRABuffer(nullptr), bounds.width,
+                          bounds.height, data, width, height, filter);
+          S25ConvertPixels(data, data, size / 4, conversions);
+        });
+      } else {
+        if (scale != 1.0) {
+          composite = S25Resample(composite, width, height, filter);
+        }
+
+        // straight alpha BGRA is ARGB32 on little endian hosts
+        auto image = QImage(composite.getBGRABuffer(nullptr), width, height,
+                            QImage::Format_ARGB32);
+
+        QByteArray bytes;
+        QBuffer    buffer(&bytes);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+
+        size = bytes.size();
+        path = createSegment(client, size, [&](uchar *data) {
+          std::memcpy(data, bytes.constData(), size);
+        });
+      }
+    }
+
+    if (path.isEmpty()) {
+      return makeError(id, "failed to allocate shared memory");
+    }
+
+    return QJsonObject{
+        {"id", id},
+        {"ok", true},
+        {"format", format},
+        {"premultiplied", (conversions & kS25ConvertPremultiply) != 0},
+        {"width", width},
+        {"height", height},
+        {"offsetX", bounds.x},
+        {"offsetY", bounds.y},
+        {"shm", path},
+        {"size", static_cast<qint64>(size)},
+    };
+  }();
+
+  // renders grow the caches of the archive they used
+  if (session) {
+    enforceMemoryBudget(session);
+  }
+
+  auto elapsed = timer.nsecsElapsed() / 1000;
+
+  if (m_latencies.size() < kLatencySamples) {
+    m_latencies.push_back(elapsed);
+  } else {
+    m_latencies[m_requestCount % kLatencySamples] = elapsed;
+  }
+
+  m_requestCount++;
+
+  if (!reply["ok"].toBool()) {
+    m_failedCount++;
+  }
+
+  reply["latencyUs"] = static_cast<qint64>(elapsed);
+
+  return reply;
+}
+
+QJsonObject S25RenderServer::getStatistics() const {
+  auto sorted = m_latencies;
+  std::sort(sorted.begin(), sorted.end());
+
+  auto percentile = [&](double p) -> qint64 {
+    if (sorted.empty()) {
+      return 0;
+    }
+
+    auto index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+  };
+
+  qint64 total = 0;
+  for (auto latency : sorted) {
+    total += latency;
+  }
+
+  qint64 mean = sorted.empty() ? 0 : total / static_cast<qint64>(sorted.size());
+  qint64 max  = sorted.empty() ? 0 : sorted.back();
+
+  QJsonArray archives;
+
+  for (auto const &session : m_archives) {
+    auto stats = session->cache.getStatistics();
+
+    archives.append(QJsonObject{
+        {"path", session->path},
+        {"hotHits", static_cast<qint64>(stats.hotHits)},
+        {"warmHits", static_cast<qint64>(stats.warmHits)},
+        {"misses", static_cast<qint64>(stats.misses)},
+        {"warmRawBytes", static_cast<qint64>(stats.warmRawBytes)},
+        {"warmCompressedBytes", static_cast<qint64>(stats.warmCompressedBytes)},
+        {"compressionRatio", stats.getCompressionRatio()},
+        {"decompressBytesPerSecond", stats.getDecompressThroughput()},
+    });
+  }
+
+  return QJsonObject{
+      {"requests", static_cast<qint64>(m_requestCount)},
+      {"failed", static_cast<qint64>(m_failedCount)},
+      {"samples", static_cast<qint64>(sorted.size())},
+      {"meanUs", mean},
+      {"p50Us", percentile(0.50)},
+      {"p95Us", percentile(0.95)},
+      {"p99Us", percentile(0.99)},
+      {"maxUs", max},
+      {"archives", archives},
+  };
+}
+
+S25ArchiveSession *S25RenderServer::openArchive(QString const &path) {
+  auto it = std::find_if(m_archives.begin(), m_archives.end(),
+                         [&](std::unique_ptr<S25ArchiveSession> const &s) {
+                           return s->path == path;
+                         });
+
+  if (it != m_archives.end()) {
+    m_governor.activate(**it);
+    return it->get();
+  }
+
+  auto archive = S25pSharedArchive(path.toUtf8());
+  if (!archive) {
+    return nullptr;
+  }
+
+  // drop the least recently used archive
+  if (m_archives.size() >= kMaxArchives) {
+    auto lru = std::min_element(
+        m_archives.begin(), m_archives.end(),
+        [](std::unique_ptr<S25ArchiveSession> const &a,
+           std::unique_ptr<S25ArchiveSession> const &b) {
+          return a->lastUsed < b->lastUsed;
+        });
+
+    m_archives.erase(lru);
+  }
+
+  m_archives.push_back(
+      std::make_unique<S25ArchiveSession>(path, std::move(archive)));
+
+  auto session = m_archives.back().get();
+  m_governor.activate(*session);
+
+  enforceMemoryBudget(session);
+
+  return session;
+}
+
+void S25RenderServer::enforceMemoryBudget(S25ArchiveSession const *active) {
+  // keep decoded entries of all warm archives under one budget
+  std::vector<S25ArchiveSession *> sessions;
+  for (auto &s : m_archives) {
+    sessions.push_back(s.get());
+  }
+
+  m_governor.enforce(sessions, active, [](S25ArchiveSession &) {});
+}
+
+QString S25RenderServer::getSegmentDirectory() const {
+  // tmpfs backed on Linux; elsewhere a regular temporary file is mapped
+  if (QFileInfo(QStringLiteral("/dev/shm")).isWritable()) {
+    return QStringLiteral("/dev/shm");
+  }
+
+  return QDir::tempPath();
+}
+
+QString S25RenderServer::createSegment(QLocalSocket *client, size_t size,
+                                       WriteFn const &write) {
+  // The segment directory is usually world-writable: a random name created
+  // exclusively (never through an existing file or symlink) with mode 0600
+  // keeps other users from redirecting or reading the result.
+  QTemporaryFile file(QString("%1/s25viewer-%2-XXXXXX")
+                          .arg(getSegmentDirectory())
+                          .arg(QCoreApplication::applicationPid()));
+
+  if (!file.open()) {
+    return QString{};
+  }
+
+  auto path = file.fileName();
+
+  // removed again by `file` on every failure below
+  if (!file.resize(size)) {
+    return QString{};
+  }
+
+  // the mapping is only valid while `file` is alive
+  auto data = file.map(0, size);
+
+  if (!data) {
+    return QString{};
+  }
+
+  write(data);
+  file.unmap(data);
+
+  // owned by the client from here on; removed on release or disconnect
+  file.setAutoRemove(false);
+
+  m_segments[client][path] = size;
+
+  return path;
+}
+
+void S25RenderServer::releaseSegment(QLocalSocket * client,
+                                     QString const &path) {
+  auto &segments = m_segments[client];
+
+  // only buffers handed to this client may be removed
+  if (segments.erase(path) > 0) {
+    QFile::remove(path);
+  }
+}
@@ -0,0 +1,83 @@
+#ifndef S25RENDERSERVER_H
+#define S25RENDERSERVER_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+
+#include "S25ArchiveSession.h"
+#include "S25MemoryGovernor.h"
+
+// Headless render service (`S25Viewer --serve <name>`).
+//
+// Clients connect to a local socket and send one JSON object per line:
+//
+//   {"id": 1, "archive": "/path/a.s25", "layers": [0, -1, 3],
+//    "scale": 0.5, "format": "bgra" | "rgba" | "png",
+//    "premultiplied": false, "filter": "box" | "bilinear" | "lanczos"}
+//   {"requests": [ ... ]}        batch; answered with {"results": [ ... ]}
+//   {"release": "/dev/shm/..."}  frees a result buffer
+//   {"stats": true}              request latency statistics
+//
+// `layers` holds the pict layer of each layer (-1 hides it), as in the
+// viewer.  Results are written into a shared memory file whose path is
+// returned in the reply; it stays valid until released or until the client
+// disconnects.  Recently used archives and their decoded entries stay warm.
+class S25RenderServer : public QObject {
+  Q_OBJECT
+public:
+  static constexpr size_t kMaxArchives    = 8;
+  static constexpr size_t kLatencySamples = 1024;
+
+  S25RenderServer(QObject *parent = nullptr);
+  ~S25RenderServer();
+
+  bool    listen(QString const &name);
+  QString getErrorString() const;
+
+private slots:
+  void newConnection();
+  void readyRead();
+  void disconnected();
+
+private:
+  using Segments = std::map<QString, size_t>;
+
+  QLocalServer m_server;
+
+  std::vector<std::unique_ptr<S25ArchiveSession>> m_archives;
+  S25MemoryGovernor                               m_governor;
+
+  std::map<QLocalSocket *, Segments> m_segments;
+
+  std::vector<int64_t> m_latencies; // microseconds, ring buffer
+  size_t               m_requestCount;
+  size_t               m_failedCount;
+
+  QJsonObject handleRequest(QJsonObject const &request, QLocalSocket *client);
+  QJsonObject render(QJsonObject const &request, QLocalSocket *client);
+  QJsonObject getStatistics() const;
+
+  S25ArchiveSession *openArchive(QString const &path);
+  void               enforceMemoryBudget(S25ArchiveSession const *active);
+
+  using WriteFn = std::function<void(uchar *)>;
+
+  // creates a shared memory file of `size` bytes, readable by this user
+  // only, and fills it through `write` while mapped; returns its (random)
+  // path, or an empty string on failure
+  QString createSegment(QLocalSocket *client, size_t size,
+                        WriteFn const &write);
+  void    releaseSegment(QLocalSocket *client, QString const &path);
+  QString getSegmentDirectory() const;
+};
+
+#endif // S25RENDERSERVER_H
@@ -0,0 +1,656 @@
+#include "S25Renderer.h"
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QRectF>
+
+#include "S25ProgramCache.h"
+#include "S25Resample.h"
+
+static const char *vertShader =
+    "#version 330\n"
+    "layout(location = 0) in"
+    "          vec2  vert;\n"
+    "layout(location = 1) in"
+    "          vec2  uv_;\n"
+    "out       vec2  uv;\n"
+    "uniform   mat4  transform;\n"
+    "\n"
+    "void main() {\n"
+    "  uv = uv_;\n"
+    "  gl_Position = transform * vec4(vert, 0, 1);\n"
+    "}";
+
+static const char *fragShader = "#version 330\n"
+                                "uniform sampler2D u_image;"
+                                "in      vec2      uv;"
+                                "out     vec4      f_color;"
+                                "\n"
+                                "void main() {\n"
+                                "  f_color = texture(u_image, uv);\n"
+                                "}";
+
+static float uvBuffer[] = {
+    0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 0.0, 1.0, 1.0, 0.0, 1.0, 1.0,
+};
+
+// size of the texture uploaded for `image`
+static QSize getTextureSize(S25pImage const &image, double textureScale) {
+  if (textureScale >= 1.0) {
+    return QSize(image.getWidth(), image.getHeight());
+  }
+
+  return QSize(std::max(1, qRound(image.getWidth() * textureScale)),
+               std::max(1, qRound(image.getHeight() * textureScale)));
+}
+
+// the two triangles covering `image`, relative to `origin`
+static void writeQuad(QOpenGLFunctions *f, GLuint buffer,
+                      S25pImage const &image, QPointF const &origin) {
+  auto x1 = (float)(image.getOffsetX() - origin.x());
+  auto y1 = (float)(image.getOffsetY() - origin.y());
+  auto x2 = x1 + (float)image.getWidth();
+  auto y2 = y1 + (float)image.getHeight();
+
+  float buf[] = {
+      x1, y1, x2, y1, x1, y2, x1, y2, x2, y1, x2, y2,
+  };
+
+  f->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  f->glBufferData(GL_ARRAY_BUFFER, sizeof(buf), buf, GL_STATIC_DRAW);
+}
+
+S25Renderer::S25Renderer()
+    : m_below{0, 0, QSize(), true}, m_above{0, 0, QSize(), true},
+      m_cacheVertexBuffer{0}, m_cacheSession{nullptr}, m_cacheOrigin{},
+      m_cacheBytes{0}, m_cacheDirty{true}, m_cacheValid{false},
+      m_activeLayer{-1}, m_uvBuffer{0}, m_transform{0},
+      m_vao{}, m_program{0}, m_overrideLayer{0}, m_overrideTexture{0},
+      m_timings{} {}
+
+bool S25Renderer::initialize() {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  f->glEnable(GL_FRAMEBUFFER_SRGB);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  bool fromCache = false;
+  m_program      = S25LinkProgram(vertShader, fragShader, &fromCache);
+
+  if (!m_program) {
+    return false;
+  }
+
+  qInfo("shader program %s in %lld ms", fromCache ? "loaded" : "compiled",
+        static_cast<long long>(timer.elapsed()));
+
+  m_transform = f->glGetUniformLocation(m_program, "transform");
+
+  return true;
+}
+
+void S25Renderer::createResources() {
+  if (m_vao.isCreated()) {
+    return;
+  }
+
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  m_vao.create();
+  m_vao.bind();
+
+  f->glGenBuffers(1, &m_uvBuffer);
+  f->glBindBuffer(GL_ARRAY_BUFFER, m_uvBuffer);
+  f->glBufferData(GL_ARRAY_BUFFER, sizeof(uvBuffer), uvBuffer, GL_STATIC_DRAW);
+}
+
+void S25Renderer::loadLayers(S25ArchiveSession &session,
+                             double             textureScale) {
+  auto &images  = session.images;
+  auto  entries = session.archive.getTotalLayers();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // load S25 images
+  images.clear();
+
+  for (size_t i = 0; i < entries; i++) {
+    auto entry = session.imageEntries[i];
+
+    // empty image
+    if (entry == -1) {
+      images.push_back(nullptr);
+      continue;
+    }
+
+    // unchanged layers are served from the cache instead of being re-decoded
+    images.push_back(session.cache.getImage(session.reader, entry + 100 * i));
+  }
+
+  m_timings.decodeNs = timer.nsecsElapsed();
+
+  uploadLayers(session, textureScale);
+}
+
+void S25Renderer::uploadLayers(S25ArchiveSession &session,
+                               double             textureScale) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  auto &images        = session.images;
+  auto &textures      = session.textures;
+  auto &textureImages = session.textureImages;
+  auto  entries       = images.size();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // a new resolution, or textures released by the memory governor
+  if (textures.size() != entries || session.textureScale != textureScale) {
+    f->glDeleteTextures(textures.size(), textures.data());
+
+    textures.assign(entries, 0);
+    textureImages.assign(entries, nullptr);
+    session.textureScale = textureScale;
+  }
+
+  session.textureBytes  = 0;
+  m_timings.uploadBytes = 0;
+
+  for (size_t i = 0; i < entries; i++) {
+    // unchanged layers keep their texture
+    if (images[i] == textureImages[i]) {
+      if (images[i]) {
+        auto size = getTextureSize(*images[i], textureScale);
+        session.textureBytes += static_cast<size_t>(size.width()) *
+                                size.height() * 4;
+      }
+
+      continue;
+    }
+
+    if (static_cast<long>(i) != m_activeLayer) {
+      m_cacheDirty = true;
+    }
+
+    f->glDeleteTextures(1, &textures[i]);
+    textures[i]      = 0;
+    textureImages[i] = images[i];
+
+    if (!images[i]) {
+      continue;
+    }
+
+    auto upload = images[i];
+    auto size   = getTextureSize(*images[i], textureScale);
+
+    // zoomed out: upload a filtered, reduced image rather than relying on
+    // GL_LINEAR minification of the full-size texture
+    if (textureScale < 1.0) {
+      upload = std::make_shared<const S25pImage>(
+          S25Resample(*images[i], size.width(), size.height(),
+                      S25ResampleFilter::kLanczos3));
+    }
+
+    const auto &img = *upload;
+
+    f->glGenTextures(1, &textures[i]);
+    f->glBindTexture(GL_TEXTURE_2D, textures[i]);
+
+    f->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.getWidth(), img.getHeight(),
+                    0, GL_BGRA, GL_UNSIGNED_BYTE, img.getBGRABuffer(nullptr));
+
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    auto bytes = static_cast<size_t>(img.getWidth()) * img.getHeight() * 4;
+
+    session.textureBytes += bytes;
+    m_timings.uploadBytes += bytes;
+  }
+
+  // the composites around the active layer count against the same budget
+  if (&session == m_cacheSession) {
+    session.textureBytes += m_cacheBytes;
+  }
+
+  m_timings.uploadNs = timer.nsecsElapsed();
+
+  session.resident = true;
+}
+
+QPointF S25Renderer::getOrigin(S25ArchiveSession const &session) {
+  float max_width  = 0;
+  float max_height = 0;
+
+  float max_oX = 0;
+  float max_oY = 0;
+
+  for (auto const &image : session.images) {
+    if (!image) {
+      continue;
+    }
+
+    const auto &img = *image;
+
+    if (max_width < img.getWidth()) {
+      max_width = img.getWidth();
+      max_oX    = img.getOffsetX();
+    }
+
+    if (max_height < img.getHeight()) {
+      max_height = img.getHeight();
+      max_oY     = img.getOffsetY();
+    }
+  }
+
+  return QPointF(max_width * 0.5f + max_oX, max_height * 0.5f + max_oY);
+}
+
+void S25Renderer::loadVertexBuffers(S25ArchiveSession &session) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  auto &images        = session.images;
+  auto &vertexBuffers = session.vertexBuffers;
+  auto  entries       = images.size();
+
+  // clear vertex buffers
+  f->glDeleteBuffers(vertexBuffers.size(), vertexBuffers.data());
+
+  vertexBuffers.resize(entries, 0);
+  f->glGenBuffers(entries, vertexBuffers.data());
+
+  auto origin = getOrigin(session);
+
+  // the cached composites are placed relative to the origin
+  if (&session == m_cacheSession && origin != m_cacheOrigin) {
+    m_cacheDirty = true;
+  }
+
+  session.vertexOrigin = origin;
+
+  for (size_t i = 0; i < entries; i++) {
+    if (images[i]) {
+      writeQuad(f, vertexBuffers[i], *images[i], origin);
+    }
+  }
+}
+
+void S25Renderer::loadVertexBuffer(S25ArchiveSession &session, size_t layer) {
+  auto &images        = session.images;
+  auto &vertexBuffers = session.vertexBuffers;
+
+  // a frame of another extent may move the origin, and with it every quad
+  if (layer >= images.size() || vertexBuffers.size() != images.size() ||
+      getOrigin(session) != session.vertexOrigin) {
+    loadVertexBuffers(session);
+    return;
+  }
+
+  if (images[layer]) {
+    auto f = QOpenGLContext::currentContext()->functions();
+    writeQuad(f, vertexBuffers[layer], *images[layer], session.vertexOrigin);
+  }
+}
+
+void S25Renderer::releaseTextures(S25ArchiveSession &session) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  f->glDeleteTextures(session.textures.size(), session.textures.data());
+  f->glDeleteBuffers(session.vertexBuffers.size(),
+                     session.vertexBuffers.data());
+
+  if (&session == m_cacheSession) {
+    releaseLayerCaches();
+  }
+
+  session.textures.clear();
+  session.textureImages.clear();
+  session.vertexBuffers.clear();
+  session.textureBytes = 0;
+  session.resident     = false;
+}
+
+void S25Renderer::setLayerTexture(size_t layer, GLuint texture) {
+  // an override of a layer inside the composites (or its removal) changes
+  // what they hold
+  auto cached = [this](size_t overridden, GLuint replacement) {
+    return replacement && static_cast<long>(overridden) != m_activeLayer;
+  };
+
+  if (cached(m_overrideLayer, m_overrideTexture) || cached(layer, texture)) {
+    m_cacheDirty = true;
+  }
+
+  m_overrideLayer   = layer;
+  m_overrideTexture = texture;
+}
+
+void S25Renderer::setActiveLayer(long layer) {
+  if (layer != m_activeLayer) {
+    m_activeLayer = layer;
+    m_cacheDirty  = true;
+  }
+}
+
+void S25Renderer::paint(S25ArchiveSession &session,
+                        QTransform const & transform) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  m_vao.bind();
+
+  f->glUseProgram(m_program);
+
+  f->glEnable(GL_BLEND);
+
+  f->glEnableVertexAttribArray(0);
+  f->glEnableVertexAttribArray(1);
+
+  f->glBindBuffer(GL_ARRAY_BUFFER, m_uvBuffer);
+  f->glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+  auto entries = std::min(session.images.size(), session.textures.size());
+  auto active  = static_cast<size_t>(m_activeLayer);
+  auto cached  = m_activeLayer >= 0 && active < entries;
+
+  if (cached && (m_cacheDirty || m_cacheSession != &session)) {
+    buildLayerCaches(session);
+  }
+
+  if (!cached || !m_cacheValid) {
+    setTransform(transform);
+
+    f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    drawLayers(session, 0, entries);
+  } else {
+    setTransform(transform);
+
+    // the composites hold premultiplied colour
+    f->glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (!m_below.empty) {
+      drawQuad(m_below.texture, m_cacheVertexBuffer);
+    }
+
+    f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    drawLayers(session, active, active + 1);
+
+    f->glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (!m_above.empty) {
+      drawQuad(m_above.texture, m_cacheVertexBuffer);
+    }
+  }
+
+  f->glFinish();
+
+  m_timings.frameNs = timer.nsecsElapsed();
+}
+
+void S25Renderer::setTransform(QTransform const &transform) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  GLfloat mat[16] = {
+      static_cast<float>(transform.m11()),
+      static_cast<float>(transform.m12()),
+      0,
+      static_cast<float>(transform.m13()), //
+      static_cast<float>(transform.m21()),
+      static_cast<float>(transform.m22()),
+      0,
+      static_cast<float>(transform.m23()), //
+      0,
+      0,
+      1,
+      0, //
+      static_cast<float>(transform.m31()),
+      static_cast<float>(transform.m32()),
+      0,
+      static_cast<float>(transform.m33()), //
+  };
+
+  f->glUniformMatrix4fv(m_transform, 1, GL_FALSE, mat);
+}
+
+void S25Renderer::drawLayers(S25ArchiveSession &session, size_t begin,
+                             size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    if (!session.images[i]) {
+      continue;
+    }
+
+    auto tex = session.textures[i];
+
+    if (m_overrideTexture && i == m_overrideLayer) {
+      tex = m_overrideTexture;
+    }
+
+    drawQuad(tex, session.vertexBuffers[i]);
+  }
+}
+
+void S25Renderer::drawQuad(GLuint texture, GLuint vertexBuffer) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  f->glBindTexture(GL_TEXTURE_2D, texture);
+
+  f->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  f->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+  f->glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void S25Renderer::buildLayerCaches(S25ArchiveSession &session) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  auto entries = std::min(session.images.size(), session.textures.size());
+  auto active  = static_cast<size_t>(m_activeLayer);
+  auto origin  = getOrigin(session);
+
+  // the cache textures are charged to the session they were built for
+  if (m_cacheSession) {
+    m_cacheSession->textureBytes -= m_cacheBytes;
+  }
+
+  m_cacheSession = &session;
+  m_cacheOrigin  = origin;
+  m_cacheBytes   = 0;
+  m_cacheDirty   = false;
+  m_cacheValid   = true;
+
+  // canvas: the union of every layer but the active one
+  QRectF canvas;
+
+  for (size_t i = 0; i < entries; i++) {
+    if (i == active || !session.images[i]) {
+      continue;
+    }
+
+    auto const &img = *session.images[i];
+
+    canvas |= QRectF(img.getOffsetX() - origin.x(),
+                     img.getOffsetY() - origin.y(), img.getWidth(),
+                     img.getHeight());
+  }
+
+  if (canvas.isEmpty()) {
+    deleteLayerCacheTextures();
+    return;
+  }
+
+  // same resolution as the layer textures, so that a 1:1 view copies texels
+  auto scale = session.textureScale;
+  auto size  = QSize(std::max(1, qRound(canvas.width() * scale)),
+                     std::max(1, qRound(canvas.height() * scale)));
+
+  GLint maxSize = 0;
+  f->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+  // far apart layers may span more than a texture can hold; they are drawn
+  // one by one until the next rebuild
+  if (size.width() > maxSize || size.height() > maxSize) {
+    qWarning("layer cache of %dx%d exceeds GL_MAX_TEXTURE_SIZE %d",
+             size.width(), size.height(), maxSize);
+
+    deleteLayerCacheTextures();
+    m_cacheValid = false;
+    return;
+  }
+
+  float x1 = canvas.left();
+  float y1 = canvas.top();
+  float x2 = canvas.right();
+  float y2 = canvas.bottom();
+
+  float buf[] = {
+      x1, y1, x2, y1, x1, y2, x1, y2, x2, y1, x2, y2,
+  };
+
+  if (!m_cacheVertexBuffer) {
+    f->glGenBuffers(1, &m_cacheVertexBuffer);
+  }
+
+  f->glBindBuffer(GL_ARRAY_BUFFER, m_cacheVertexBuffer);
+  f->glBufferData(GL_ARRAY_BUFFER, sizeof(buf), buf, GL_STATIC_DRAW);
+
+  // the caller's target, e.g. the framebuffer of QOpenGLWidget
+  GLint   framebuffer = 0;
+  GLint   viewport[4];
+  GLfloat clearColor[4];
+
+  f->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+  f->glGetIntegerv(GL_VIEWPORT, viewport);
+  f->glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+  // not flipped: the top of the canvas lands in the first texture row, as
+  // with the layer textures
+  setTransform(QTransform()
+                   .translate(-1, -1)
+                   .scale(2.0 / canvas.width(), 2.0 / canvas.height())
+                   .translate(-canvas.left(), -canvas.top()));
+
+  f->glViewport(0, 0, size.width(), size.height());
+  f->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+  // colour blends as on screen; alpha accumulates with ONE, which leaves a
+  // premultiplied result
+  f->glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                         GL_ONE_MINUS_SRC_ALPHA);
+
+  m_cacheValid = buildLayerCache(m_below, size, session, 0, active) &&
+                 buildLayerCache(m_above, size, session, active + 1, entries);
+
+  f->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  f->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  f->glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+  if (!m_cacheValid) {
+    qWarning("layer cache framebuffer of %dx%d is incomplete", size.width(),
+             size.height());
+
+    deleteLayerCacheTextures();
+    return;
+  }
+
+  for (auto cache : {&m_below, &m_above}) {
+    if (cache->texture) {
+      m_cacheBytes +=
+          static_cast<size_t>(cache->size.width()) * cache->size.height() * 4;
+    }
+  }
+
+  session.textureBytes += m_cacheBytes;
+}
+
+bool S25Renderer::buildLayerCache(LayerCache &cache, QSize const &size,
+                                  S25ArchiveSession &session, size_t begin,
+                                  size_t end) {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  cache.empty = true;
+
+  for (size_t i = begin; i < end; i++) {
+    if (session.images[i]) {
+      cache.empty = false;
+    }
+  }
+
+  if (cache.empty) {
+    return true;
+  }
+
+  if (!cache.texture) {
+    f->glGenTextures(1, &cache.texture);
+    f->glGenFramebuffers(1, &cache.framebuffer);
+
+    f->glBindTexture(GL_TEXTURE_2D, cache.texture);
+
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  }
+
+  f->glBindFramebuffer(GL_FRAMEBUFFER, cache.framebuffer);
+
+  if (cache.size != size) {
+    f->glBindTexture(GL_TEXTURE_2D, cache.texture);
+    f->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.width(), size.height(), 0,
+                    GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    f->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_TEXTURE_2D, cache.texture, 0);
+    cache.size = size;
+  }
+
+  // e.g. out of memory for the texture storage
+  if (f->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    return false;
+  }
+
+  f->glClear(GL_COLOR_BUFFER_BIT);
+
+  drawLayers(session, begin, end);
+
+  return true;
+}
+
+void S25Renderer::deleteLayerCacheTextures() {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  for (auto cache : {&m_below, &m_above}) {
+    f->glDeleteFramebuffers(1, &cache->framebuffer);
+    f->glDeleteTextures(1, &cache->texture);
+
+    *cache = LayerCache{0, 0, QSize(), true};
+  }
+}
+
+void S25Renderer::releaseLayerCaches() {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  deleteLayerCacheTextures();
+
+  f->glDeleteBuffers(1, &m_cacheVertexBuffer);
+
+  if (m_cacheSession) {
+    m_cacheSession->textureBytes -= m_cacheBytes;
+  }
+
+  m_cacheVertexBuffer = 0;
+  m_cacheSession      = nullptr;
+  m_cacheBytes        = 0;
+  m_cacheDirty        = true;
+  m_cacheValid        = false;
+}
+
+S25Renderer::Timings S25Renderer::getTimings() const { return m_timings; }
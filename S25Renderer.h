@@ -0,0 +1,118 @@
+#ifndef S25RENDERER_H
+#define S25RENDERER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <QPointF>
+#include <QSize>
+#include <QTransform>
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+#include <QOpenGLVertexArrayObject>
+#else
+#include <QtOpenGL/QOpenGLVertexArrayObject>
+#endif
+
+#include "S25ArchiveSession.h"
+
+// Draws the layers of an S25ArchiveSession with OpenGL.
+//
+// Owns the shader program and creates the textures and vertex buffers kept in
+// each session.  All functions expect the same context to be current.  Used
+// by S25ImageView and by the offscreen render check.
+class S25Renderer {
+public:
+  // of the most recent loadLayers() and paint() calls
+  struct Timings {
+    int64_t decodeNs;
+    int64_t uploadNs;
+    int64_t frameNs;
+    size_t  uploadBytes;
+  };
+
+  S25Renderer();
+
+  // links the shader program; false if that failed
+  bool initialize();
+
+  // VAO and uv buffer; not needed until there is something to draw
+  void createResources();
+
+  // Fetches the selected pict layers through the session cache and uploads
+  // the ones that changed.  Below 1, `textureScale` uploads filtered, reduced
+  // images instead of relying on GL_LINEAR minification.
+  void loadLayers(S25ArchiveSession &session, double textureScale = 1.0);
+
+  // the upload half of loadLayers(), for `images` filled by the caller
+  // (the synthetic layers of the render check)
+  void uploadLayers(S25ArchiveSession &session, double textureScale = 1.0);
+  void loadVertexBuffers(S25ArchiveSession &session);
+  // rewrites the quad of `layer` only, or every quad if the origin moved
+  void loadVertexBuffer(S25ArchiveSession &session, size_t layer);
+  void releaseTextures(S25ArchiveSession &session);
+
+  // draws `layer` from `texture` instead of the session's own texture
+  // (flipbook playback); a texture of 0 switches back
+  void setLayerTexture(size_t layer, GLuint texture);
+
+  // The layers below and above `layer` are kept composited in two
+  // canvas-sized textures, so that a frame in which only `layer` changes
+  // (an edit or a flipbook step) draws three quads.  The composites are
+  // rebuilt when any other layer changes; their size is added to the
+  // session's `textureBytes`.  -1, or composites the GL cannot hold, draw
+  // every layer directly.
+  void setActiveLayer(long layer);
+
+  // `transform` maps the coordinates of the vertex buffers, see getOrigin(),
+  // to clip space
+  void paint(S25ArchiveSession &session, QTransform const &transform);
+
+  Timings getTimings() const;
+
+  // where image offset (0, 0) lies in the coordinates of the vertex buffers
+  static QPointF getOrigin(S25ArchiveSession const &session);
+
+private:
+  // premultiplied composite of a range of layers, in canvas space
+  struct LayerCache {
+    GLuint framebuffer;
+    GLuint texture;
+    QSize  size;
+    bool   empty;
+  };
+
+  LayerCache          m_below;
+  LayerCache          m_above;
+  GLuint              m_cacheVertexBuffer;
+  S25ArchiveSession * m_cacheSession;
+  QPointF             m_cacheOrigin;
+  size_t              m_cacheBytes; // charged to m_cacheSession
+  bool                m_cacheDirty;
+  bool                m_cacheValid;
+  long                m_activeLayer;
+
+  GLuint m_uvBuffer;
+  GLuint m_transform;
+
+  QOpenGLVertexArrayObject m_vao;
+  GLuint                   m_program;
+
+  size_t m_overrideLayer;
+  GLuint m_overrideTexture;
+
+  Timings m_timings;
+
+  void setTransform(QTransform const &transform);
+  void drawLayers(S25ArchiveSession &session, size_t begin, size_t end);
+  void drawQuad(GLuint texture, GLuint vertexBuffer);
+  void buildLayerCaches(S25ArchiveSession &session);
+  // false if the framebuffer is incomplete
+  bool buildLayerCache(LayerCache &cache, QSize const &size,
+                       S25ArchiveSession &session, size_t begin, size_t end);
+  void deleteLayerCacheTextures();
+  void releaseLayerCaches();
+};
+
+#endif // S25RENDERER_H
@@ -0,0 +1,451 @@
+#include "S25Resample.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "S25PixelFormat.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||           \
+    defined(_M_IX86)
+#define S25_RESAMPLE_X86
+#include <immintrin.h>
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+// part of the baseline; AVX2 is picked at run time
+#define S25_RESAMPLE_SSE2
+#endif
+#if defined(_MSC_VER)
+#define S25_TARGET(x)
+#else
+#define S25_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define S25_RESAMPLE_NEON
+#endif
+
+namespace {
+
+// output rows per work item
+constexpr int kTileRows = 64;
+
+constexpr double kPi = 3.14159265358979323846;
+
+double filterSupport(S25ResampleFilter filter) {
+  switch (filter) {
+  case S25ResampleFilter::kBox:
+    return 0.5;
+  case S25ResampleFilter::kBilinear:
+    return 1.0;
+  case S25ResampleFilter::kLanczos3:
+    return 3.0;
+  }
+
+  return 1.0;
+}
+
+double sinc(double x) {
+  if (x == 0.0) {
+    return 1.0;
+  }
+
+  x *= kPi;
+  return std::sin(x) / x;
+}
+
+double filterWeight(S25ResampleFilter filter, double x) {
+  x = std::abs(x);
+
+  switch (filter) {
+  case S25ResampleFilter::kBox:
+    return x <= 0.5 ? 1.0 : 0.0;
+  case S25ResampleFilter::kBilinear:
+    return x < 1.0 ? 1.0 - x : 0.0;
+  case S25ResampleFilter::kLanczos3:
+    return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+  }
+
+  return 0.0;
+}
+
+// source taps of every output sample along one axis
+struct Contributions {
+  std::vector<int>   start;
+  std::vector<int>   count;
+  std::vector<float> weights; // `stride` weights per output sample
+  int                stride;
+};
+
+Contributions computeContributions(int srcSize, int dstSize,
+                                   S25ResampleFilter filter) {
+  double scale = static_cast<double>(dstSize) / srcSize;
+
+  // widen the kernel when minifying so that every source pixel contributes
+  double filterScale = std::max(1.0, 1.0 / scale);
+  double support     = filterSupport(filter) * filterScale;
+
+  Contributions c;
+  c.stride = static_cast<int>(std::ceil(support)) * 2 + 1;
+  c.start.resize(dstSize);
+  c.count.resize(dstSize);
+  c.weights.assign(static_cast<size_t>(dstSize) * c.stride, 0.0f);
+
+  for (int i = 0; i < dstSize; i++) {
+    double center = (i + 0.5) / scale;
+    int    first  = std::max(0, static_cast<int>(std::floor(center - support)));
+    int    last   = std::min(srcSize,
+                          static_cast<int>(std::ceil(center + support)));
+
+    last = std::min(last, first + c.stride);
+
+    double total   = 0.0;
+    auto   weights = &c.weights[static_cast<size_t>(i) * c.stride];
+
+    for (int j = first; j < last; j++) {
+      auto w = filterWeight(filter, (j + 0.5 - center) / filterScale);
+
+      weights[j - first] = static_cast<float>(w);
+      total += w;
+    }
+
+    // nearest pixel if the kernel missed every sample (tiny box filters)
+    if (total == 0.0) {
+      first      = std::min(srcSize - 1, static_cast<int>(center));
+      last       = first + 1;
+      weights[0] = 1.0f;
+      total      = 1.0;
+    }
+
+    for (int j = 0; j < last - first; j++) {
+      weights[j] = static_cast<float>(weights[j] / total);
+    }
+
+    c.start[i] = first;
+    c.count[i] = last - first;
+  }
+
+  return c;
+}
+
+// straight BGRA row to premultiplied floats (0..255)
+void premultiplyRow(const uint8_t *src, float *dst, int width) {
+  for (int x = 0; x < width; x++, src += 4, dst += 4) {
+    float a = src[3] * (1.0f / 255.0f);
+
+    dst[0] = src[0] * a;
+    dst[1] = src[1] * a;
+    dst[2] = src[2] * a;
+    dst[3] = src[3];
+  }
+}
+
+// one output row of the horizontal pass; the reference for the SIMD ones
+void filterRowScalar(const float *src, float *dst, Contributions const &h,
+                     int dstWidth) {
+  for (int x = 0; x < dstWidth; x++, dst += 4) {
+    auto weights = &h.weights[static_cast<size_t>(x) * h.stride];
+    auto s       = src + static_cast<size_t>(h.start[x]) * 4;
+    auto n       = h.count[x];
+
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (int k = 0; k < n; k++) {
+      for (int c = 0; c < 4; c++) {
+        acc[c] += s[k * 4 + c] * weights[k];
+      }
+    }
+
+    std::copy(acc, acc + 4, dst);
+  }
+}
+
+// dst += src * w over one row of the vertical pass; plain float loop that
+// the compiler vectorises for the baseline
+void accumulateRowScalar(float *dst, const float *src, float w, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    dst[i] += src[i] * w;
+  }
+}
+
+#if defined(S25_RESAMPLE_SSE2)
+
+// one pixel per vector
+void filterRowSSE2(const float *src, float *dst, Contributions const &h,
+                   int dstWidth) {
+  for (int x = 0; x < dstWidth; x++, dst += 4) {
+    auto weights = &h.weights[static_cast<size_t>(x) * h.stride];
+    auto s       = src + static_cast<size_t>(h.start[x]) * 4;
+    auto n       = h.count[x];
+
+    auto acc = _mm_setzero_ps();
+
+    for (int k = 0; k < n; k++) {
+      auto px = _mm_loadu_ps(s + k * 4);
+      acc     = _mm_add_ps(acc, _mm_mul_ps(px, _mm_set1_ps(weights[k])));
+    }
+
+    _mm_storeu_ps(dst, acc);
+  }
+}
+
+#endif
+
+#if defined(S25_RESAMPLE_X86)
+
+// w[0] in the low four lanes, w[1] in the high four
+S25_TARGET("avx2")
+inline __m256 tapPairWeights(const float *w) {
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(w[0])),
+                              _mm_set1_ps(w[1]), 1);
+}
+
+// Two adjacent taps (two source pixels) per vector, with two accumulators
+// to hide the add latency; the halves are summed at the end.
+S25_TARGET("avx2")
+void filterRowAVX2(const float *src, float *dst, Contributions const &h,
+                   int dstWidth) {
+  for (int x = 0; x < dstWidth; x++, dst += 4) {
+    auto weights = &h.weights[static_cast<size_t>(x) * h.stride];
+    auto s       = src + static_cast<size_t>(h.start[x]) * 4;
+    auto n       = h.count[x];
+
+    auto acc0 = _mm256_setzero_ps();
+    auto acc1 = _mm256_setzero_ps();
+    int  k    = 0;
+
+    for (; k + 4 <= n; k += 4) {
+      acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(s + k * 4),
+                                               tapPairWeights(weights + k)));
+      acc1 = _mm256_add_ps(acc1,
+                           _mm256_mul_ps(_mm256_loadu_ps(s + k * 4 + 8),
+                                         tapPairWeights(weights + k + 2)));
+    }
+
+    if (k + 2 <= n) {
+      acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(s + k * 4),
+                                               tapPairWeights(weights + k)));
+      k += 2;
+    }
+
+    acc0     = _mm256_add_ps(acc0, acc1);
+    auto acc = _mm_add_ps(_mm256_castps256_ps128(acc0),
+                          _mm256_extractf128_ps(acc0, 1));
+
+    if (k < n) {
+      acc = _mm_add_ps(
+          acc, _mm_mul_ps(_mm_loadu_ps(s + k * 4), _mm_set1_ps(weights[k])));
+    }
+
+    _mm_storeu_ps(dst, acc);
+  }
+}
+
+S25_TARGET("avx2")
+void accumulateRowAVX2(float *dst, const float *src, float w, size_t n) {
+  auto weight = _mm256_set1_ps(w);
+
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    auto d = _mm256_loadu_ps(dst + i);
+    d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(src + i), weight));
+    _mm256_storeu_ps(dst + i, d);
+  }
+
+  accumulateRowScalar(dst + i, src + i, w, n - i);
+}
+
+#elif defined(S25_RESAMPLE_NEON)
+
+void filterRowNEON(const float *src, float *dst, Contributions const &h,
+                   int dstWidth) {
+  for (int x = 0; x < dstWidth; x++, dst += 4) {
+    auto weights = &h.weights[static_cast<size_t>(x) * h.stride];
+    auto s       = src + static_cast<size_t>(h.start[x]) * 4;
+    auto n       = h.count[x];
+
+    auto acc = vdupq_n_f32(0.0f);
+
+    for (int k = 0; k < n; k++) {
+      acc = vmlaq_n_f32(acc, vld1q_f32(s + k * 4), weights[k]);
+    }
+
+    vst1q_f32(dst, acc);
+  }
+}
+
+#endif
+
+struct Kernels {
+  const char *name;
+  void (*filterRow)(const float *, float *, Contributions const &, int);
+  void (*accumulateRow)(float *, const float *, float, size_t);
+};
+
+// every set the running CPU supports, fastest first
+std::vector<Kernels> selectKernelSets() {
+  std::vector<Kernels> sets;
+
+#if defined(S25_RESAMPLE_X86)
+  if (S25CpuHasAVX2()) {
+    sets.push_back(Kernels{"avx2", filterRowAVX2, accumulateRowAVX2});
+  }
+#endif
+
+#if defined(S25_RESAMPLE_SSE2)
+  sets.push_back(Kernels{"sse2", filterRowSSE2, accumulateRowScalar});
+#elif defined(S25_RESAMPLE_NEON)
+  sets.push_back(Kernels{"neon", filterRowNEON, accumulateRowScalar});
+#endif
+
+  sets.push_back(Kernels{"scalar", filterRowScalar, accumulateRowScalar});
+  return sets;
+}
+
+std::vector<Kernels> const &getKernelSets() {
+  static const std::vector<Kernels> sets = selectKernelSets();
+  return sets;
+}
+
+// the set in use; an out of range `set` picks the scalar one
+Kernels const &getKernels(size_t set = 0) {
+  auto const &sets = getKernelSets();
+  return sets[std::min(set, sets.size() - 1)];
+}
+
+// premultiplied floats back to straight BGRA bytes
+void unpremultiplyRow(const float *src, uint8_t *dst, int width) {
+  for (int x = 0; x < width; x++, src += 4, dst += 4) {
+    float a = std::min(std::max(src[3], 0.0f), 255.0f);
+
+    if (a < 0.5f) {
+      dst[0] = dst[1] = dst[2] = dst[3] = 0;
+      continue;
+    }
+
+    float k = 255.0f / a;
+
+    for (int c = 0; c < 3; c++) {
+      float v = std::min(std::max(src[c] * k, 0.0f), 255.0f);
+      dst[c]  = static_cast<uint8_t>(v + 0.5f);
+    }
+
+    dst[3] = static_cast<uint8_t>(a + 0.5f);
+  }
+}
+
+} // namespace
+
+void S25ResampleInto(const uint8_t *src, int srcWidth, int srcHeight,
+                     uint8_t *dst, int dstWidth, int dstHeight,
+                     S25ResampleFilter filter, int threads) {
+  S25ResampleIntoUsing(0, src, srcWidth, srcHeight, dst, dstWidth, dstHeight,
+                       filter, threads);
+}
+
+void S25ResampleIntoUsing(size_t set, const uint8_t *src, int srcWidth,
+                          int srcHeight, uint8_t *dst, int dstWidth,
+                          int dstHeight, S25ResampleFilter filter,
+                          int threads) {
+  if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) {
+    return;
+  }
+
+  auto h = computeContributions(srcWidth, dstWidth, filter);
+  auto v = computeContributions(srcHeight, dstHeight, filter);
+
+  auto tiles = (dstHeight + kTileRows - 1) / kTileRows;
+
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  threads = std::min(threads, tiles);
+
+  std::atomic<int> nextTile{0};
+
+  auto const &kernels = getKernels(set);
+
+  auto worker = [&]() {
+    std::vector<float> srcRow(static_cast<size_t>(srcWidth) * 4);
+    std::vector<float> outRow(static_cast<size_t>(dstWidth) * 4);
+    std::vector<float> rows; // horizontally filtered source rows of a tile
+
+    for (int tile; (tile = nextTile++) < tiles;) {
+      auto y1 = tile * kTileRows;
+      auto y2 = std::min(dstHeight, y1 + kTileRows);
+
+      // source rows needed by this tile
+      auto first = v.start[y1];
+      auto last  = first;
+
+      for (int y = y1; y < y2; y++) {
+        last = std::max(last, v.start[y] + v.count[y]);
+      }
+
+      rows.resize(static_cast<size_t>(last - first) * dstWidth * 4);
+
+      for (int sy = first; sy < last; sy++) {
+        premultiplyRow(src + static_cast<size_t>(sy) * srcWidth * 4,
+                       srcRow.data(), srcWidth);
+        auto row = &rows[static_cast<size_t>(sy - first) * dstWidth * 4];
+        kernels.filterRow(srcRow.data(), row, h, dstWidth);
+      }
+
+      // vertical pass
+      for (int y = y1; y < y2; y++) {
+        auto weights = &v.weights[static_cast<size_t>(y) * v.stride];
+
+        std::fill(outRow.begin(), outRow.end(), 0.0f);
+
+        for (int k = 0; k < v.count[y]; k++) {
+          auto row = &rows[static_cast<size_t>(v.start[y] + k - first) *
+                           dstWidth * 4];
+
+          kernels.accumulateRow(outRow.data(), row, weights[k],
+                                outRow.size());
+        }
+
+        unpremultiplyRow(outRow.data(),
+                         dst + static_cast<size_t>(y) * dstWidth * 4, dstWidth);
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+
+  for (int i = 1; i < threads; i++) {
+    pool.emplace_back(worker);
+  }
+
+  worker();
+
+  for (auto &thread : pool) {
+    thread.join();
+  }
+}
+
+size_t S25GetResampleKernelSetCount() { return getKernelSets().size(); }
+
+const char *S25GetResampleKernelSetName(size_t set) {
+  return getKernels(set).name;
+}
+
+S25pImage S25Resample(S25pImage const &image, int width, int height,
+                      S25ResampleFilter filter, int threads) {
+  std::vector<uint8_t> buffer(static_cast<size_t>(width) * height * 4);
+
+  S25ResampleInto(image.getBGRABuffer(nullptr), image.getWidth(),
+                  image.getHeight(), buffer.data(), width, height, filter,
+                  threads);
+
+  auto sx = static_cast<double>(width) / image.getWidth();
+  auto sy = static_cast<double>(height) / image.getHeight();
+
+  return S25pImage(width, height,
+                   static_cast<int>(std::lround(image.getOffsetX() * sx)),
+                   static_cast<int>(std::lround(image.getOffsetY() * sy)),
+                   std::move(buffer));
+}
@@ -0,0 +1,37 @@
+#ifndef S25RESAMPLE_H
+#define S25RESAMPLE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "S25DecoderWrapper.h"
+
+enum class S25ResampleFilter {
+  kBox = 0,
+  kBilinear,
+  kLanczos3,
+};
+
+// Resizes straight-alpha BGRA pixels.  Filtering is done on premultiplied
+// values so that colours of fully transparent pixels do not bleed into the
+// edges of a layer.  Work is split into row tiles over `threads` threads
+// (0 picks the hardware concurrency).
+void S25ResampleInto(const uint8_t *src, int srcWidth, int srcHeight,
+                     uint8_t *dst, int dstWidth, int dstHeight,
+                     S25ResampleFilter filter, int threads = 0);
+
+// resized copy of `image`; the offset is scaled along with the pixels
+S25pImage S25Resample(S25pImage const &image, int width, int height,
+                      S25ResampleFilter filter, int threads = 0);
+
+// For the kernel check: the kernel sets the running CPU supports, the one in
+// use first and "scalar" last, and S25ResampleInto() through one of them (an
+// out of range `set` picks the scalar one).
+size_t      S25GetResampleKernelSetCount();
+const char *S25GetResampleKernelSetName(size_t set);
+void        S25ResampleIntoUsing(size_t set, const uint8_t *src, int srcWidth,
+                                 int srcHeight, uint8_t *dst, int dstWidth,
+                                 int dstHeight, S25ResampleFilter filter,
+                                 int threads = 0);
+
+#endif // S25RESAMPLE_H
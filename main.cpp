@@ -1,14 +1,53 @@
+#include "S25KernelCheck.h"
+#include "S25RenderCheck.h"
+#include "S25RenderServer.h"
 #include "widget.h"
 
 #include <QApplication>
+#include <QCoreApplication>
+#include <QGuiApplication>
 #include <QSurfaceFormat>
 
 int main(int argc, char *argv[]) {
+  // headless render service: S25Viewer --serve <socket name>
+  for (int i = 1; i + 1 < argc; i++) {
+    if (qstrcmp(argv[i], "--serve") == 0) {
+      QCoreApplication a(argc, argv);
+      S25RenderServer  server;
+
+      if (!server.listen(QString::fromLocal8Bit(argv[i + 1]))) {
+        qCritical("failed to listen: %s", qPrintable(server.getErrorString()));
+        return 1;
+      }
+
+      return a.exec();
+    }
+  }
+
+  // CPU kernels against their scalar versions: S25Viewer --kernel-check
+  for (int i = 1; i < argc; i++) {
+    if (qstrcmp(argv[i], "--kernel-check") == 0) {
+      return S25RunKernelCheck();
+    }
+  }
+
   QSurfaceFormat fmt;
   fmt.setVersion(4, 0);
   fmt.setProfile(QSurfaceFormat::CoreProfile);
   QSurfaceFormat::setDefaultFormat(fmt);
 
+  // offscreen comparison with the CPU composite:
+  // S25Viewer --render-check [archive]; synthetic layers without an archive
+  for (int i = 1; i < argc; i++) {
+    if (qstrcmp(argv[i], "--render-check") == 0) {
+      auto path =
+          i + 1 < argc ? QString::fromLocal8Bit(argv[i + 1]) : QString();
+
+      QGuiApplication a(argc, argv);
+      return S25RunRenderCheck(path);
+    }
+  }
+
   QApplication a(argc, argv);
   Widget       w;
   w.show();
@@ -9,6 +9,7 @@ extern "C" {
 #endif
 
 struct S25Archive;
+struct S25SharedArchive;
 struct S25Image;
 
 typedef int32_t S25DecoderError;
@@ -26,6 +27,16 @@ S25Archive *S25ArchiveOpen(const char *path);
 void        S25ArchiveRelease(S25Archive *archive);
 S25Image *  S25ArchiveLoadImage(S25Archive *archive, size_t entry);
 size_t      S25ArchiveGetTotalEntries(const S25Archive *archive);
+
+// thread-safe archive; each thread decodes through its own leased reader,
+// which is a regular S25Archive usable with S25ArchiveLoadImage
+S25SharedArchive *S25SharedArchiveOpen(const char *path);
+void              S25SharedArchiveRelease(S25SharedArchive *archive);
+size_t S25SharedArchiveGetTotalEntries(const S25SharedArchive *archive);
+S25Archive *S25SharedArchiveAcquireReader(const S25SharedArchive *archive);
+void        S25SharedArchiveReturnReader(const S25SharedArchive *archive,
+                                         S25Archive *            reader);
+
 void        S25ImageRelease(S25Image *image);
 void        S25ImageGetSize(const S25Image *image, int *width, int *height);
 void        S25ImageGetOffset(const S25Image *image, int *x, int *y);
@@ -2,6 +2,17 @@
 
 use s25::{S25Archive, S25Image};
 use std::ffi::CStr;
+use std::sync::Mutex;
+
+/// An archive that can be decoded from several threads at once.
+///
+/// `S25Archive` needs `&mut self` to decode, so the shared archive keeps a
+/// pool of open handles and leases one per reader.
+pub struct S25SharedArchive {
+    path: String,
+    total_entries: usize,
+    idle: Mutex<Vec<Box<S25Archive>>>,
+}
 
 unsafe fn s25_archive_open(path: *const u8) -> Option<S25Archive> {
     let path = CStr::from_ptr(path as *const _);
@@ -47,6 +58,82 @@ pub unsafe extern "C" fn S25ArchiveGetTotalEntries(
     archive.total_entries()
 }
 
+// shared archive
+
+#[no_mangle]
+pub unsafe extern "C" fn S25SharedArchiveOpen(
+    path: *const u8,
+) -> *mut S25SharedArchive {
+    let archive = match s25_archive_open(path) {
+        Some(archive) => archive,
+        None => return std::ptr::null_mut::<S25SharedArchive>(),
+    };
+
+    // `s25_archive_open` has already validated the path
+    let path = CStr::from_ptr(path as *const _).to_string_lossy().into_owned();
+
+    let shared = S25SharedArchive {
+        path,
+        total_entries: archive.total_entries(),
+        idle: Mutex::new(vec![Box::new(archive)]),
+    };
+
+    Box::leak(Box::new(shared)) as *mut _
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn S25SharedArchiveRelease(archive: *mut S25SharedArchive) {
+    if archive.is_null() {
+        return;
+    }
+
+    drop(Box::from_raw(archive));
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn S25SharedArchiveGetTotalEntries(
+    archive: *const S25SharedArchive,
+) -> usize {
+    let archive = &*archive;
+    archive.total_entries
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn S25SharedArchiveAcquireReader(
+    archive: *const S25SharedArchive,
+) -> *mut S25Archive {
+    let archive = &*archive;
+
+    let idle = archive.idle.lock().ok().and_then(|mut idle| idle.pop());
+
+    // all handles are leased; open another one outside the lock
+    let reader = match idle {
+        Some(reader) => Some(reader),
+        None => S25Archive::open(&archive.path).ok().map(Box::new),
+    };
+
+    reader
+        .map(|reader| Box::leak(reader) as *mut _)
+        .unwrap_or_else(|| std::ptr::null_mut::<S25Archive>())
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn S25SharedArchiveReturnReader(
+    archive: *const S25SharedArchive,
+    reader: *mut S25Archive,
+) {
+    if reader.is_null() {
+        return;
+    }
+
+    let archive = &*archive;
+    let reader = Box::from_raw(reader);
+
+    if let Ok(mut idle) = archive.idle.lock() {
+        idle.push(reader);
+    }
+}
+
 // image
 
 #[no_mangle]
@@ -1,46 +1,36 @@
 // #include <QDebug>
+#include <algorithm>
+
 #include <QDrag>
 #include <QDropEvent>
+#include <QElapsedTimer>
 #include <QMimeData>
 #include <QOpenGLFunctions>
 
 #include "S25DecoderWrapper.h"
 #include "s25imageview.h"
 
-static const char *vertShader =
-    "#version 330\n"
-    "layout(location = 0) in"
-    "          vec2  vert;\n"
-    "layout(location = 1) in"
-    "          vec2  uv_;\n"
-    "out       vec2  uv;\n"
-    "uniform   vec2  viewport;\n"
-    "uniform   mat4  transform;\n"
-    "\n"
-    "void main() {\n"
-    "  uv = uv_;\n"
-    "  gl_Position = transform * vec4(vert, 0, 1);\n"
-    "}";
-
-static const char *fragShader = "#version 330\n"
-                                "uniform sampler2D u_image;"
-                                "in      vec2      uv;"
-                                "out     vec4      f_color;"
-                                "\n"
-                                "void main() {\n"
-                                "  f_color = texture(u_image, uv);\n"
-                                "}";
-
-static float uvBuffer[] = {
-    0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 0.0, 1.0, 1.0, 0.0, 1.0, 1.0,
-};
+// started during static initialization, i.e. at launch; the cold start time
+// is reported with the first frame
+static QElapsedTimer const launchTimer = [] {
+  QElapsedTimer timer;
+  timer.start();
+  return timer;
+}();
 
 S25ImageView::S25ImageView(QWidget *parent)
-    : QOpenGLWidget(parent), m_archive{std::nullopt}, m_images{},
-      m_imageEntries{}, m_textures{}, m_viewportWidth{0},
-      m_currentScale{1}, m_scale{1} {
+    : QOpenGLWidget(parent), m_sessions{}, m_session{nullptr}, m_governor{},
+      m_flipbook{}, m_flipbookTextures{0, 0}, m_flipbookFront{-1},
+      m_flipbookBytes{0},
+      m_renderer{}, m_firstFramePainted{false},
+      m_viewportWidth{0}, m_currentScale{1}, m_scale{1}, m_textureScale{1} {
   grabGesture(Qt::PanGesture);
   grabGesture(Qt::PinchGesture);
+
+  connect(&m_flipbook, SIGNAL(frameChanged()), this,
+          SLOT(flipbookFrameChanged()));
+  connect(&m_flipbook, SIGNAL(frameDecoded()), this,
+          SLOT(flipbookFrameDecoded()));
 }
 
 bool S25ImageView::event(QEvent *event) {
@@ -69,6 +59,8 @@ void S25ImageView::gestureEvent(QGestureEvent *event) {
     if (gesture->state() == Qt::GestureFinished) {
       m_scale *= m_currentScale;
       m_currentScale = 1.0;
+
+      updateTextureScale();
     }
   }
 
@@ -97,103 +89,293 @@ void S25ImageView::wheelEvent(QWheelEvent *event) {
 }
 
 int S25ImageView::getTotalLayers() const {
-  if (m_archive) {
-    return m_archive->getTotalLayers();
+  if (m_session) {
+    return m_session->archive.getTotalLayers();
   }
 
   return 0;
 }
 
 int S25ImageView::getPictLayerFor(unsigned long layer) const {
-  if (m_archive && layer < m_imageEntries.size()) {
-    return m_imageEntries[layer];
+  if (m_session && layer < m_session->imageEntries.size()) {
+    return m_session->imageEntries[layer];
   }
 
   return -1;
 }
 
 bool S25ImageView::getPictLayerIsValid(unsigned long layer) const {
-  if (m_archive && layer < m_images.size()) {
-    return !!m_images[layer] || m_imageEntries[layer] == -1;
+  if (m_session && layer < m_session->images.size()) {
+    return !!m_session->images[layer] || m_session->imageEntries[layer] == -1;
   }
 
   return false;
 }
 
 void S25ImageView::setPictLayer(unsigned long layer, int pictLayer) {
-  if (m_archive && layer < m_images.size()) {
-    m_imageEntries[layer] = pictLayer;
+  if (m_session && layer < m_session->images.size()) {
+    m_session->imageEntries[layer] = pictLayer;
 
+    // the layers around the edited one are drawn from cached composites; a
+    // playing flipbook keeps its own layer active
+    if (!m_flipbook.isPlaying()) {
+      m_renderer.setActiveLayer(layer);
+    }
+
+    makeCurrent();
     loadImagesToTexture();
     loadVertexBuffers();
+    doneCurrent();
 
     update();
   }
 }
 
-void S25ImageView::initializeGL() {
+S25ImageCache::Statistics S25ImageView::getCacheStatistics() const {
+  if (m_session) {
+    return m_session->cache.getStatistics();
+  }
+
+  return S25ImageCache::Statistics{};
+}
+
+int S25ImageView::getSessionCount() const { return m_sessions.size(); }
+
+int S25ImageView::getCurrentSessionIndex() const {
+  for (size_t i = 0; i < m_sessions.size(); i++) {
+    if (m_sessions[i].get() == m_session) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+QString S25ImageView::getSessionPath(int index) const {
+  if (index < 0 || index >= getSessionCount()) {
+    return QString{};
+  }
+
+  return m_sessions[index]->path;
+}
+
+void S25ImageView::setCurrentSession(int index) {
+  if (index < 0 || index >= getSessionCount()) {
+    return;
+  }
+
+  auto session = m_sessions[index].get();
+  if (session == m_session) {
+    return;
+  }
+
+  stopFlipbook();
+
+  m_session = session;
+  m_governor.activate(*m_session);
+
+  m_renderer.setActiveLayer(-1);
+
+  // restore evicted state lazily, only for the archive being shown
+  if (!m_session->resident) {
+    makeCurrent();
+    loadImagesToTexture();
+    loadVertexBuffers();
+    doneCurrent();
+  }
+
+  emit currentSessionChanged(index);
+  emit imageLoaded(QUrl::fromLocalFile(m_session->path));
+
+  update();
+}
+
+void S25ImageView::closeSession(int index) {
+  if (index < 0 || index >= getSessionCount()) {
+    return;
+  }
+
+  auto wasCurrent = m_sessions[index].get() == m_session;
+
+  if (wasCurrent) {
+    stopFlipbook();
+  }
+
+  makeCurrent();
+  m_renderer.releaseTextures(*m_sessions[index]);
+  doneCurrent();
+
+  m_sessions.erase(m_sessions.begin() + index);
+
+  emit sessionClosed(index);
+
+  if (wasCurrent) {
+    m_session = nullptr;
+
+    if (!m_sessions.empty()) {
+      setCurrentSession(std::min<int>(index, getSessionCount() - 1));
+    }
+  }
+
+  update();
+}
+
+S25MemoryGovernor &S25ImageView::getMemoryGovernor() { return m_governor; }
+
+void S25ImageView::startFlipbook(unsigned long layer, double frameRate) {
+  if (!m_session || layer >= m_session->imageEntries.size()) {
+    return;
+  }
+
+  m_renderer.setActiveLayer(layer);
+
+  m_flipbook.start(m_session->archive, &m_session->cache, layer, frameRate);
+}
+
+void S25ImageView::stopFlipbook() {
+  if (!m_flipbook.isPlaying()) {
+    return;
+  }
+
+  m_flipbook.stop();
+
+  // go back to the regular per-layer texture, showing the last frame
+  makeCurrent();
+
   auto f = QOpenGLContext::currentContext()->functions();
+  f->glDeleteTextures(2, m_flipbookTextures);
 
-  f->glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  f->glClearDepthf(1.0f);
+  m_flipbookTextures[0]     = 0;
+  m_flipbookTextures[1]     = 0;
+  m_flipbookTextureSizes[0] = QSize();
+  m_flipbookTextureSizes[1] = QSize();
+  m_flipbookFront           = -1;
+  m_flipbookStaged          = nullptr;
+  m_flipbookBytes           = 0;
 
-  f->glEnable(GL_FRAMEBUFFER_SRGB);
+  m_renderer.setLayerTexture(0, 0);
 
-  // create shader program
+  loadImagesToTexture();
+  loadVertexBuffers();
 
-  auto vShader = f->glCreateShader(GL_VERTEX_SHADER);
+  doneCurrent();
 
-  f->glShaderSource(vShader, 1, &vertShader, nullptr);
-  f->glCompileShader(vShader);
+  update();
+}
 
-  GLint result;
-  GLint log_length;
+S25FlipbookPlayer &S25ImageView::getFlipbookPlayer() { return m_flipbook; }
 
-  f->glGetShaderiv(vShader, GL_COMPILE_STATUS, &result);
-  f->glGetShaderiv(vShader, GL_INFO_LOG_LENGTH, &log_length);
+void S25ImageView::uploadFlipbookFrame(int index, S25pImage const &image) {
+  auto f    = QOpenGLContext::currentContext()->functions();
+  auto size = QSize(image.getWidth(), image.getHeight());
 
-  std::vector<char> errMessage(log_length);
-  f->glGetShaderInfoLog(vShader, log_length, NULL, errMessage.data());
-  // qDebug() << "vertex shader status: " << errMessage.data();
+  if (!m_flipbookTextures[index]) {
+    f->glGenTextures(1, &m_flipbookTextures[index]);
+    f->glBindTexture(GL_TEXTURE_2D, m_flipbookTextures[index]);
 
-  auto fShader = f->glCreateShader(GL_FRAGMENT_SHADER);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  }
 
-  f->glShaderSource(fShader, 1, &fragShader, nullptr);
-  f->glCompileShader(fShader);
+  f->glBindTexture(GL_TEXTURE_2D, m_flipbookTextures[index]);
 
-  f->glGetShaderiv(fShader, GL_COMPILE_STATUS, &result);
-  f->glGetShaderiv(fShader, GL_INFO_LOG_LENGTH, &log_length);
+  if (m_flipbookTextureSizes[index] == size) {
+    // same extent; skip reallocating the texture storage
+    f->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(),
+                       GL_BGRA, GL_UNSIGNED_BYTE, image.getBGRABuffer(nullptr));
+  } else {
+    f->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.width(), size.height(), 0,
+                    GL_BGRA, GL_UNSIGNED_BYTE, image.getBGRABuffer(nullptr));
 
-  errMessage.resize(log_length, 0);
-  f->glGetShaderInfoLog(fShader, log_length, NULL, errMessage.data());
-  // qDebug() << "frag shader status: " << errMessage.data();
+    auto bytes = [](QSize const &s) {
+      return static_cast<size_t>(s.width()) * s.height() * 4;
+    };
 
-  auto program = f->glCreateProgram();
-  f->glAttachShader(program, vShader);
-  f->glAttachShader(program, fShader);
-  f->glLinkProgram(program);
+    auto previous = bytes(m_flipbookTextureSizes[index]);
+    auto current  = bytes(size);
 
-  f->glGetProgramiv(program, GL_LINK_STATUS, &result);
-  f->glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
+    m_flipbookTextureSizes[index] = size;
+    m_flipbookBytes               = m_flipbookBytes - previous + current;
+    m_session->textureBytes = m_session->textureBytes - previous + current;
 
-  errMessage.resize(log_length, 0);
-  f->glGetProgramInfoLog(program, log_length, NULL, errMessage.data());
-  // qDebug() << "link status: " << errMessage.data();
+    if (current > previous) {
+      enforceMemoryBudget();
+    }
+  }
+}
 
-  f->glDeleteShader(vShader);
-  f->glDeleteShader(fShader);
+void S25ImageView::flipbookFrameDecoded() {
+  // upload the next frame while the current one is on screen, so that
+  // showing it only swaps the textures
+  auto image = m_flipbook.getNextImage();
 
-  m_program = program;
+  if (!m_session || !image || image == m_flipbookStaged) {
+    return;
+  }
 
-  m_vao.create();
-  m_vao.bind();
+  makeCurrent();
+  uploadFlipbookFrame(m_flipbookFront == 0 ? 1 : 0, *image);
+  doneCurrent();
 
-  f->glGenBuffers(1, &m_uvBuffer);
-  f->glBindBuffer(GL_ARRAY_BUFFER, m_uvBuffer);
-  f->glBufferData(GL_ARRAY_BUFFER, sizeof(uvBuffer), uvBuffer, GL_STATIC_DRAW);
+  m_flipbookStaged = std::move(image);
+}
 
-  m_viewport  = f->glGetUniformLocation(program, "viewport");
-  m_transform = f->glGetUniformLocation(program, "transform");
+void S25ImageView::flipbookFrameChanged() {
+  auto image = m_flipbook.getCurrentImage();
+  auto layer = m_flipbook.getLayer();
+
+  if (!m_session || !image || layer >= m_session->images.size()) {
+    return;
+  }
+
+  makeCurrent();
+
+  auto back = m_flipbookFront == 0 ? 1 : 0;
+
+  // the staged frame was skipped, or this one was due before it was staged
+  if (image != m_flipbookStaged) {
+    uploadFlipbookFrame(back, *image);
+  }
+
+  m_flipbookStaged = nullptr;
+  m_flipbookFront  = back;
+  m_renderer.setLayerTexture(layer, m_flipbookTextures[back]);
+
+  m_session->images[layer]       = image;
+  m_session->imageEntries[layer] = m_flipbook.getCurrentPictLayer();
+
+  // frames of one layer may differ in size and offset
+  m_renderer.loadVertexBuffer(*m_session, layer);
+
+  doneCurrent();
+
+  // the previous front texture is free now; stage the following frame
+  flipbookFrameDecoded();
+
+  update();
+}
+
+void S25ImageView::initializeGL() {
+  auto f = QOpenGLContext::currentContext()->functions();
+
+  f->glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  f->glClearDepthf(1.0f);
+
+  // the VAO and uv buffer wait for the first archive
+  m_renderer.initialize();
+}
+
+void S25ImageView::reportFirstFrame() {
+  if (m_firstFramePainted) {
+    return;
+  }
+
+  m_firstFramePainted = true;
+
+  qInfo("first frame %lld ms after launch",
+        static_cast<long long>(launchTimer.elapsed()));
 }
 
 void S25ImageView::paintGL() {
@@ -202,77 +384,29 @@ void S25ImageView::paintGL() {
   // clear
   f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  m_vao.bind();
-
   // guard empty S25 archive
-  if (!m_archive) {
+  if (!m_session) {
     f->glFinish();
+    reportFirstFrame();
     return;
   }
 
-  // qDebug() << "paintGL call";
-
-  auto &archive = *m_archive;
-  auto  entries = archive.getTotalLayers();
-
-  f->glUseProgram(m_program);
-  f->glUniform2f(m_viewport, m_viewportWidth, m_viewportHeight);
-
   // create transform
   auto const tr = QTransform()
                       .scale(1.0 / m_viewportWidth, -1.0 / m_viewportHeight)
                       .translate(m_offset.x(), m_offset.y())
                       .scale(m_scale * m_currentScale, m_scale * m_currentScale);
 
-  GLfloat mat[16] = {
-      static_cast<float>(tr.m11()),
-      static_cast<float>(tr.m12()),
-      0,
-      static_cast<float>(tr.m13()), //
-      static_cast<float>(tr.m21()),
-      static_cast<float>(tr.m22()),
-      0,
-      static_cast<float>(tr.m23()), //
-      0,
-      0,
-      1,
-      0, //
-      static_cast<float>(tr.m31()),
-      static_cast<float>(tr.m32()),
-      0,
-      static_cast<float>(tr.m33()), //
-  };
-
-  f->glUniformMatrix4fv(m_transform, 1, GL_FALSE, mat);
-
-  f->glEnable(GL_BLEND);
-  f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-  f->glEnableVertexAttribArray(0);
-  f->glEnableVertexAttribArray(1);
-
-  f->glBindBuffer(GL_ARRAY_BUFFER, m_uvBuffer);
-  f->glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
-
-  for (size_t i = 0; i < entries; i++) {
-    if (!m_images[i]) {
-      continue;
-    }
-
-    // qDebug() << "paint entry: " << i;
-
-    auto tex = m_textures[i];
-    auto vtx = m_vertexBuffers[i];
+  auto textureBytes = m_session->textureBytes;
 
-    f->glBindTexture(GL_TEXTURE_2D, tex);
+  m_renderer.paint(*m_session, tr);
 
-    f->glBindBuffer(GL_ARRAY_BUFFER, vtx);
-    f->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
-
-    f->glDrawArrays(GL_TRIANGLES, 0, 6);
+  // rebuilt layer composites may have grown the session
+  if (m_session->textureBytes > textureBytes) {
+    enforceMemoryBudget();
   }
 
-  f->glFinish();
+  reportFirstFrame();
 }
 
 void S25ImageView::resizeGL(int width, int height) {
@@ -293,17 +427,38 @@ void S25ImageView::dropEvent(QDropEvent *theEvent) {
   }
 
   const auto url = theEvent->mimeData()->urls().first();
-  if (loadArchive(url.toLocalFile())) {
-    emit imageLoaded(url);
+
+  // the archive is already open; just switch to its tab
+  for (int i = 0; i < getSessionCount(); i++) {
+    if (m_sessions[i]->path == url.toLocalFile()) {
+      setCurrentSession(i);
+      return;
+    }
+  }
+
+  stopFlipbook();
+
+  if (!loadArchive(url.toLocalFile())) {
+    return;
   }
 
   m_offset       = QPoint();
   m_currentScale = 1.0;
   m_scale        = 1.0;
+  m_textureScale = 1.0;
+
+  m_renderer.setActiveLayer(-1);
 
   // load S25 into texture
+  makeCurrent();
+  m_renderer.createResources();
   loadImagesToTexture();
   loadVertexBuffers();
+  doneCurrent();
+
+  emit sessionOpened(url);
+  emit currentSessionChanged(getCurrentSessionIndex());
+  emit imageLoaded(url);
 
   // force update
   update();
@@ -311,7 +466,7 @@ void S25ImageView::dropEvent(QDropEvent *theEvent) {
 
 bool S25ImageView::loadArchive(QString const &path) {
   auto pathAsUtf8 = path.toUtf8();
-  auto arc        = S25pArchive(pathAsUtf8);
+  auto arc        = S25pSharedArchive(pathAsUtf8);
 
   if (!arc) {
     // archive load failed
@@ -322,129 +477,70 @@ bool S25ImageView::loadArchive(QString const &path) {
   // qDebug() << "image loaded: " << path << ", with " << arc.getTotalEntries()
   //         << "entries";
 
-  // select nothing
-  m_imageEntries.resize(arc.getTotalLayers(), -1);
+  // open a new session with nothing selected
+  m_sessions.push_back(
+      std::make_unique<S25ArchiveSession>(path, std::move(arc)));
 
-  m_archive = std::make_optional(std::move(arc));
+  m_session = m_sessions.back().get();
+  m_governor.activate(*m_session);
 
   return true;
 }
 
 void S25ImageView::loadVertexBuffers() {
-  auto f = QOpenGLContext::currentContext()->functions();
-
   // guard empty S25 archive
-  if (!m_archive) {
+  if (!m_session) {
     return;
   }
 
-  // qDebug() << "load vertex buffers";
-
-  auto &archive = *m_archive;
-  auto  entries = archive.getTotalLayers();
-
-  // clear vertex buffers
-  f->glDeleteBuffers(m_vertexBuffers.size(), m_vertexBuffers.data());
-
-  m_vertexBuffers.resize(entries, 0);
-  f->glGenBuffers(entries, m_vertexBuffers.data());
-
-  float max_width  = 0;
-  float max_height = 0;
-
-  float max_oX = 0;
-  float max_oY = 0;
-
-  for (size_t i = 0; i < entries; i++) {
-    if (!m_images[i]) {
-      continue;
-    }
-
-    const auto &img = *m_images[i];
-
-    if (max_width < img.getWidth()) {
-      max_width = img.getWidth();
-      max_oX    = img.getOffsetX();
-    }
-
-    if (max_height < img.getHeight()) {
-      max_height = img.getHeight();
-      max_oY     = img.getOffsetY();
-    }
-  }
-
-  for (size_t i = 0; i < entries; i++) {
-    if (!m_images[i]) {
-      continue;
-    }
-
-    const auto &img = *m_images[i];
-
-    auto x1 = (float)img.getOffsetX() - max_width * 0.5f - max_oX;
-    auto y1 = (float)img.getOffsetY() - max_height * 0.5f - max_oY;
-    auto x2 = x1 + (float)img.getWidth();
-    auto y2 = y1 + (float)img.getHeight();
-
-    float buf[] = {
-        x1, y1, x2, y1, x1, y2, x1, y2, x2, y1, x2, y2,
-    };
-
-    f->glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[i]);
-    f->glBufferData(GL_ARRAY_BUFFER, sizeof(buf), buf, GL_STATIC_DRAW);
-  }
+  m_renderer.loadVertexBuffers(*m_session);
 }
 
 void S25ImageView::loadImagesToTexture() {
-  auto f = QOpenGLContext::currentContext()->functions();
-
   // guard empty S25 archive
-  if (!m_archive) {
+  if (!m_session) {
     return;
   }
 
-  auto &archive = *m_archive;
-  auto  entries = archive.getTotalLayers();
+  m_renderer.loadLayers(*m_session, m_textureScale);
 
-  // load S25 images
-  m_images.clear();
+  // recounted by loadLayers(), which does not know the flipbook textures
+  m_session->textureBytes += m_flipbookBytes;
 
-  for (size_t i = 0; i < entries; i++) {
-    auto entry = m_imageEntries[i];
+  enforceMemoryBudget();
 
-    // empty image
-    if (entry == -1) {
-      m_images.push_back(std::nullopt);
-      continue;
-    }
-
-    m_images.push_back(archive.getImage(entry + 100 * i));
-  }
+  emit cacheStatisticsChanged();
+}
 
-  // clear textures
-  f->glDeleteTextures(m_textures.size(), m_textures.data());
+void S25ImageView::updateTextureScale() {
+  // power-of-two reduction matching the zoom level, down to 1/8
+  qreal textureScale = 1.0;
 
-  // generate textures
-  m_textures.resize(entries, 0);
-  f->glGenTextures(entries, m_textures.data());
+  while (textureScale > 0.125 && m_scale <= textureScale * 0.5) {
+    textureScale *= 0.5;
+  }
 
-  for (size_t i = 0; i < entries; i++) {
-    if (!m_images[i]) {
-      continue;
-    }
+  if (textureScale == m_textureScale) {
+    return;
+  }
 
-    auto        tex = m_textures[i];
-    const auto &img = *m_images[i];
+  m_textureScale = textureScale;
 
-    // qDebug() << "load entry " << i << "; (w, h) = " << img.getWidth() << ", "
-    //         << img.getHeight();
+  makeCurrent();
+  loadImagesToTexture();
+  doneCurrent();
+}
 
-    f->glBindTexture(GL_TEXTURE_2D, tex);
-    f->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.getWidth(), img.getHeight(),
-                    0, GL_BGRA, GL_UNSIGNED_BYTE, img.getBGRABuffer(nullptr));
+void S25ImageView::enforceMemoryBudget() {
+  std::vector<S25ArchiveSession *> sessions;
 
-    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  for (auto &session : m_sessions) {
+    sessions.push_back(session.get());
   }
+
+  m_governor.enforce(
+      sessions, m_session,
+      [this](S25ArchiveSession &session) {
+        m_renderer.releaseTextures(session);
+      });
 }
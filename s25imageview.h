@@ -10,14 +10,17 @@
 #include <QWidget>
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-#include <QOpenGLVertexArrayObject>
 #include <QOpenGLWidget>
 #else
-#include <QtOpenGL/QOpenGLVertexArrayObject>
 #include <QtOpenGLWidgets/QOpenGLWidget>
 #endif
 
+#include "S25ArchiveSession.h"
 #include "S25DecoderWrapper.h"
+#include "S25FlipbookPlayer.h"
+#include "S25ImageCache.h"
+#include "S25MemoryGovernor.h"
+#include "S25Renderer.h"
 
 class S25ImageView : public QOpenGLWidget {
   Q_OBJECT
@@ -45,33 +48,67 @@ public:
 
   void setPictLayer(unsigned long layer, int pictLayer);
 
+  S25ImageCache::Statistics getCacheStatistics() const;
+
+  // open archives (tabs)
+  int     getSessionCount() const;
+  int     getCurrentSessionIndex() const;
+  QString getSessionPath(int index) const;
+
+  S25MemoryGovernor &getMemoryGovernor();
+
+  // flipbook playback of one layer's pict layers
+  void               startFlipbook(unsigned long layer, double frameRate);
+  void               stopFlipbook();
+  S25FlipbookPlayer &getFlipbookPlayer();
+
+public slots:
+  void setCurrentSession(int index);
+  void closeSession(int index);
+
+private slots:
+  void flipbookFrameChanged();
+  void flipbookFrameDecoded();
+
 signals:
   void imageLoaded(QUrl theUrl);
+  void sessionOpened(QUrl theUrl);
+  void sessionClosed(int index);
+  void currentSessionChanged(int index);
+  void cacheStatisticsChanged();
 
 private:
-  std::optional<S25pArchive>            m_archive;
-  std::vector<std::optional<S25pImage>> m_images;
-  std::vector<int32_t>                  m_imageEntries;
+  std::vector<std::unique_ptr<S25ArchiveSession>> m_sessions;
+  S25ArchiveSession *                             m_session;
+  S25MemoryGovernor                               m_governor;
 
-  std::vector<GLuint> m_textures;
-  std::vector<GLuint> m_vertexBuffers;
+  // double-buffered textures for the layer being played back; the next
+  // frame is uploaded into the back texture as soon as it is decoded
+  S25FlipbookPlayer                m_flipbook;
+  GLuint                           m_flipbookTextures[2];
+  QSize                            m_flipbookTextureSizes[2];
+  int                              m_flipbookFront;
+  std::shared_ptr<const S25pImage> m_flipbookStaged; // in the back texture
+  size_t                           m_flipbookBytes;  // in textureBytes
 
-  GLuint m_uvBuffer;
-  GLuint m_transform;
-  GLuint m_viewport;
+  S25Renderer m_renderer;
 
-  QOpenGLVertexArrayObject m_vao;
-  GLuint                   m_program;
+  bool m_firstFramePainted;
 
   int m_viewportWidth;
   int m_viewportHeight;
 
   qreal  m_currentScale, m_scale;
+  qreal  m_textureScale; // resolution of the uploaded textures
   QPoint m_offset;
 
+  void reportFirstFrame();
+  void uploadFlipbookFrame(int index, S25pImage const &image);
   bool loadArchive(QString const &path);
   void loadImagesToTexture();
   void loadVertexBuffers();
+  void updateTextureScale();
+  void enforceMemoryBudget();
 };
 
 #endif // S25IMAGEVIEW_H
@@ -1,6 +1,11 @@
 #include "widget.h"
 #include "./ui_widget.h"
 
+#include <algorithm>
+
+#include <QFileInfo>
+#include <QSignalBlocker>
+
 Widget::Widget(QWidget *parent) : QWidget(parent), ui(new Ui::Widget) {
   ui->setupUi(this);
 
@@ -11,10 +16,42 @@ Widget::Widget(QWidget *parent) : QWidget(parent), ui(new Ui::Widget) {
   m_model = new S25LayerModel(ui->tableView, ui->openGLWidget);
   ui->tableView->setModel(m_model);
 
+  // one tab per open archive
+  m_tabBar = new QTabBar(ui->viewContainer);
+  m_tabBar->setTabsClosable(true);
+  m_tabBar->setDocumentMode(true);
+  m_tabBar->setExpanding(false);
+  m_tabBar->hide();
+  ui->viewLayout->insertWidget(0, m_tabBar);
+
   connect(ui->openGLWidget, SIGNAL(imageLoaded(QUrl)), m_model,
           SLOT(updateModel()));
   connect(ui->openGLWidget, SIGNAL(imageLoaded(QUrl)), this,
           SLOT(imageLoaded(QUrl)));
+  connect(ui->openGLWidget, SIGNAL(sessionOpened(QUrl)), this,
+          SLOT(sessionOpened(QUrl)));
+  connect(ui->openGLWidget, SIGNAL(sessionClosed(int)), this,
+          SLOT(sessionClosed(int)));
+  connect(ui->openGLWidget, SIGNAL(currentSessionChanged(int)), this,
+          SLOT(currentSessionChanged(int)));
+  connect(ui->openGLWidget, SIGNAL(cacheStatisticsChanged()), this,
+          SLOT(cacheStatisticsChanged()));
+
+  connect(m_tabBar, SIGNAL(currentChanged(int)), ui->openGLWidget,
+          SLOT(setCurrentSession(int)));
+  connect(m_tabBar, SIGNAL(tabCloseRequested(int)), ui->openGLWidget,
+          SLOT(closeSession(int)));
+
+  // flipbook playback
+  auto player = &ui->openGLWidget->getFlipbookPlayer();
+
+  connect(ui->playButton, SIGNAL(toggled(bool)), this,
+          SLOT(playbackToggled(bool)));
+  connect(ui->frameRateSpinBox, SIGNAL(valueChanged(double)), this,
+          SLOT(frameRateChanged(double)));
+  connect(player, SIGNAL(statisticsChanged(int, int)), this,
+          SLOT(playbackStatisticsChanged(int, int)));
+  connect(player, SIGNAL(playbackStopped()), this, SLOT(playbackStopped()));
 }
 
 Widget::~Widget() { delete ui; }
@@ -23,3 +60,96 @@ void Widget::imageLoaded(QUrl theUrl) {
   this->setWindowTitle(tr("S25 Viewer - %1").arg(theUrl.path()));
   this->setWindowFilePath(theUrl.path());
 }
+
+void Widget::sessionOpened(QUrl theUrl) {
+  QSignalBlocker blocker(m_tabBar);
+
+  auto index = m_tabBar->addTab(QFileInfo(theUrl.toLocalFile()).fileName());
+  m_tabBar->setTabToolTip(index, theUrl.toLocalFile());
+  m_tabBar->show();
+}
+
+void Widget::sessionClosed(int index) {
+  {
+    QSignalBlocker blocker(m_tabBar);
+    m_tabBar->removeTab(index);
+  }
+
+  if (m_tabBar->count() == 0) {
+    m_tabBar->hide();
+
+    this->setWindowTitle(tr("S25 Viewer"));
+    this->setWindowFilePath(QString{});
+  }
+
+  m_model->updateModel();
+}
+
+void Widget::currentSessionChanged(int index) {
+  {
+    QSignalBlocker blocker(m_tabBar);
+    m_tabBar->setCurrentIndex(index);
+  }
+
+  cacheStatisticsChanged();
+}
+
+void Widget::cacheStatisticsChanged() {
+  auto view  = ui->openGLWidget;
+  auto index = view->getCurrentSessionIndex();
+
+  if (index < 0 || index >= m_tabBar->count()) {
+    return;
+  }
+
+  auto stats = view->getCacheStatistics();
+
+  // shown on the tab of the current archive
+  m_tabBar->setTabToolTip(
+      index, tr("%1\nCache: %2 hot hits, %3 warm hits, %4 misses\n"
+                "Warm tier: %5:1 compression, %6 MB/s decompression")
+                 .arg(view->getSessionPath(index))
+                 .arg(stats.hotHits)
+                 .arg(stats.warmHits)
+                 .arg(stats.misses)
+                 .arg(stats.getCompressionRatio(), 0, 'f', 2)
+                 .arg(stats.getDecompressThroughput() / 1e6, 0, 'f', 0));
+}
+
+void Widget::playbackToggled(bool checked) {
+  if (!checked) {
+    ui->openGLWidget->stopFlipbook();
+    return;
+  }
+
+  // play the layer selected in the table
+  auto row = ui->tableView->currentIndex().row();
+
+  ui->openGLWidget->startFlipbook(std::max(row, 0),
+                                  ui->frameRateSpinBox->value());
+
+  if (!ui->openGLWidget->getFlipbookPlayer().isPlaying()) {
+    QSignalBlocker blocker(ui->playButton);
+    ui->playButton->setChecked(false);
+  }
+}
+
+void Widget::frameRateChanged(double frameRate) {
+  ui->openGLWidget->getFlipbookPlayer().setFrameRate(frameRate);
+}
+
+void Widget::playbackStatisticsChanged(int shownFrames, int missedFrames) {
+  ui->playbackStatus->setText(tr("Layer %1: %2 frames shown, %3 missed")
+                                  .arg(ui->openGLWidget->getFlipbookPlayer()
+                                           .getLayer() +
+                                       1)
+                                  .arg(shownFrames)
+                                  .arg(missedFrames));
+}
+
+void Widget::playbackStopped() {
+  QSignalBlocker blocker(ui->playButton);
+  ui->playButton->setChecked(false);
+
+  m_model->updateModel();
+}
@@ -2,6 +2,7 @@
 #define WIDGET_H
 
 #include "S25LayerModel.h"
+#include <QTabBar>
 #include <QWidget>
 
 QT_BEGIN_NAMESPACE
@@ -18,10 +19,19 @@ public:
   ~Widget();
 public slots:
   void imageLoaded(QUrl theUrl);
+  void sessionOpened(QUrl theUrl);
+  void sessionClosed(int index);
+  void currentSessionChanged(int index);
+  void playbackToggled(bool checked);
+  void frameRateChanged(double frameRate);
+  void playbackStatisticsChanged(int shownFrames, int missedFrames);
+  void playbackStopped();
+  void cacheStatisticsChanged();
 
 private:
   Ui::Widget *ui;
 
   S25LayerModel *m_model;
+  QTabBar *      m_tabBar;
 };
 #endif // WIDGET_H